@@ -0,0 +1,196 @@
+// Benchmark for decommentGlupeSyntax on synthetic .glp input of growing size.
+// Also runs the pre-rewrite implementation (four in-place replace() passes) on the smaller
+// sizes, checks both produce identical output, and prints ns/byte so linear scaling is visible.
+//
+//   make bench
+#include "../src/parser.hpp"
+
+// --- Reference: original in-place implementation ---
+static string decommentLegacy(const string& code) {
+    string processedCode = code;
+    size_t pos = 0;
+
+    // --- Handle block comments: /* ... */ ---
+    pos = 0;
+    while ((pos = processedCode.find("/*", pos)) != string::npos) {
+        size_t endPos = processedCode.find("*/", pos + 2);
+        if (endPos == string::npos) break; // Unclosed comment, stop processing
+
+        string commentContent = processedCode.substr(pos + 2, endPos - (pos + 2));
+        
+        string trimmedContent = commentContent;
+        size_t first = trimmedContent.find_first_not_of(" \t\r\n");
+        if (first == string::npos) { // Empty or whitespace-only comment
+            pos = endPos + 2;
+            continue;
+        }
+        trimmedContent.erase(0, first);
+        size_t last = trimmedContent.find_last_not_of(" \t\r\n");
+        if (last != string::npos) trimmedContent.erase(last + 1);
+
+        bool isBlockContainer = (trimmedContent.rfind("$$", 0) == 0 && trimmedContent.rfind("$$") == trimmedContent.length() - 2);
+        bool isInlineContainer = (trimmedContent.rfind("$", 0) == 0 && trimmedContent.rfind("$") == trimmedContent.length() - 1);
+
+        if (isBlockContainer || isInlineContainer) {
+            processedCode.replace(pos, (endPos + 2) - pos, commentContent);
+            pos += commentContent.length();
+        } else {
+            pos = endPos + 2;
+        }
+    }
+
+    // --- Handle line comments: // ... ---
+    pos = 0;
+    while ((pos = processedCode.find("//", pos)) != string::npos) {
+        size_t endOfLine = processedCode.find('\n', pos);
+        if (endOfLine == string::npos) endOfLine = processedCode.length();
+
+        string commentContent = processedCode.substr(pos + 2, endOfLine - (pos + 2));
+        
+        string trimmedContent = commentContent;
+        size_t first = trimmedContent.find_first_not_of(" \t\r\n");
+        if (first == string::npos) { // Empty or whitespace-only comment
+            pos = endOfLine;
+            if (pos >= processedCode.length()) break;
+            continue;
+        }
+        trimmedContent.erase(0, first);
+        size_t last = trimmedContent.find_last_not_of(" \t\r\n");
+        if (last != string::npos) trimmedContent.erase(last + 1);
+
+        bool isInlineContainer = (trimmedContent.rfind("$", 0) == 0 && trimmedContent.rfind("$") == trimmedContent.length() - 1);
+
+        if (isInlineContainer) {
+            processedCode.replace(pos, endOfLine - pos, commentContent);
+            pos += commentContent.length();
+        } else {
+            pos = endOfLine;
+            if (pos >= processedCode.length()) break;
+        }
+    }
+
+    // --- Handle Glupe block comments: %{ ... }% ---
+    pos = 0;
+    while ((pos = processedCode.find("%{", pos)) != string::npos) {
+        size_t endPos = processedCode.find("}%", pos + 2);
+        if (endPos == string::npos) break; // Unclosed comment
+
+        string commentContent = processedCode.substr(pos + 2, endPos - (pos + 2));
+        
+        string trimmedContent = commentContent;
+        size_t first = trimmedContent.find_first_not_of(" \t\r\n");
+        if (first == string::npos) { 
+            processedCode.replace(pos, (endPos + 2) - pos, "");
+            continue;
+        }
+        trimmedContent.erase(0, first);
+        size_t last = trimmedContent.find_last_not_of(" \t\r\n");
+        if (last != string::npos) trimmedContent.erase(last + 1);
+
+        bool isBlockContainer = (trimmedContent.rfind("$$", 0) == 0 && trimmedContent.rfind("$$") == trimmedContent.length() - 2);
+        bool isInlineContainer = (trimmedContent.rfind("$", 0) == 0 && trimmedContent.rfind("$") == trimmedContent.length() - 1);
+
+        if (isBlockContainer || isInlineContainer) {
+            processedCode.replace(pos, (endPos + 2) - pos, commentContent);
+            pos += commentContent.length();
+        } else {
+            processedCode.replace(pos, (endPos + 2) - pos, "");
+        }
+    }
+
+    // --- Handle Glupe line comments: % ... ---
+    pos = 0;
+    while ((pos = processedCode.find("%", pos)) != string::npos) {
+        size_t endOfLine = processedCode.find('\n', pos);
+        if (endOfLine == string::npos) endOfLine = processedCode.length();
+
+        string commentContent = processedCode.substr(pos + 1, endOfLine - (pos + 1));
+        
+        string trimmedContent = commentContent;
+        size_t first = trimmedContent.find_first_not_of(" \t\r\n");
+        if (first == string::npos) { 
+            pos = endOfLine;
+            if (pos >= processedCode.length()) break;
+            continue;
+        }
+        trimmedContent.erase(0, first);
+        size_t last = trimmedContent.find_last_not_of(" \t\r\n");
+        if (last != string::npos) trimmedContent.erase(last + 1);
+
+        bool isInlineContainer = (trimmedContent.rfind("$", 0) == 0 && trimmedContent.rfind("$") == trimmedContent.length() - 1);
+
+        if (isInlineContainer) {
+            processedCode.replace(pos, endOfLine - pos, commentContent);
+            pos += commentContent.length();
+        } else {
+            pos = endOfLine;
+            if (pos >= processedCode.length()) break;
+        }
+    }
+    return processedCode;
+}
+
+// Mix of everything the four stages look at: commented containers in each comment style,
+// ordinary comments, %{ }% blocks that get removed, and plain code with '/', '%' and '$'.
+static string makeInput(size_t targetBytes) {
+    string s;
+    s.reserve(targetBytes + 256);
+    size_t i = 0;
+    while (s.size() < targetBytes) {
+        string n = to_string(i++);
+        s += "int v" + n + " = a / b % c; // plain comment " + n + "\n";
+        s += "% $ helper" + n + " { return " + n + "; } $\n";
+        s += "% note about the price in $ for " + n + "\n";
+        s += "%{ removed block " + n + " }%\n";
+        s += "/* $$ blk" + n + " {\n  multi line " + n + "\n}$$ */\n";
+        s += "// $ line" + n + " { x } $\n";
+        s += "%{ $ kept" + n + " { y } $ }%\n";
+        s += "/* ordinary block comment */ cout << \"$HOME\";\n";
+    }
+    return s;
+}
+
+template <typename F>
+static double timeIt(F f, int reps) {
+    double best = 1e100;
+    for (int r = 0; r < reps; r++) {
+        auto t0 = chrono::high_resolution_clock::now();
+        f();
+        auto t1 = chrono::high_resolution_clock::now();
+        best = min(best, chrono::duration<double>(t1 - t0).count());
+    }
+    return best;
+}
+
+int main(int argc, char* argv[]) {
+    size_t maxMb = argc > 1 ? (size_t)atoi(argv[1]) : 16;
+    const size_t legacyLimit = 2 << 20; // Legacy is quadratic; keep it to <= 2 MB
+
+    cout << "decommentGlupeSyntax (SSE2 " <<
+#ifdef __SSE2__
+        "on"
+#else
+        "off"
+#endif
+        ")\n";
+    cout << setw(10) << "size" << setw(14) << "new ms" << setw(12) << "new ns/B" << setw(14) << "legacy ms" << setw(14) << "legacy ns/B" << "\n";
+
+    bool ok = true;
+    for (size_t bytes = 128 << 10; bytes <= (maxMb << 20); bytes *= 2) {
+        string input = makeInput(bytes);
+        string out;
+        double t = timeIt([&]() { out = decommentGlupeSyntax(input); }, 5);
+
+        cout << setw(9) << input.size() / 1024 << "K" << setw(14) << fixed << setprecision(2) << t * 1e3
+             << setw(12) << setprecision(2) << t * 1e9 / input.size();
+        if (bytes <= legacyLimit) {
+            string ref;
+            double tl = timeIt([&]() { ref = decommentLegacy(input); }, 1);
+            cout << setw(14) << setprecision(2) << tl * 1e3 << setw(14) << setprecision(2) << tl * 1e9 / input.size();
+            if (ref != out) { cout << "  MISMATCH"; ok = false; }
+        }
+        cout << "\n";
+    }
+    if (!ok) { cerr << "[ERROR] Output differs from the reference implementation." << endl; return 1; }
+    return 0;
+}
@@ -0,0 +1,332 @@
+#!/usr/bin/env python3
+"""Local stand-in for the LLM endpoints glupe talks to.
+
+Speaks the three request/response shapes callAI/extractCode understand:
+  Ollama  POST /api/generate            -> {"response": ...}      (GET /api/tags lists models)
+  OpenAI  POST .../chat/completions     -> {"choices": [{"message": {"content": ...}}]}
+  Google  POST ...:generateContent      -> {"candidates": [{"content": {"parts": [{"text": ...}]}}]}
+
+Requests with "stream": true (Ollama, OpenAI) or to :streamGenerateContent (Google) are answered
+incrementally: NDJSON lines for Ollama, SSE "data:" events for OpenAI and Google.
+
+Every answer costs `--latency` ms plus len(text)/4 tokens at `--token-rate` tokens/s, so
+glupe's own overhead can be measured apart from model time. Failures are injected with
+`--error-rate` (HTTP 500) and `--rate-limit` (HTTP 429 + Retry-After). Answers come from a
+canned file (`--responses`) or, by default, a small program chosen from the prompt.
+
+Control endpoints (used by bench/run_bench.py):
+  GET  /__stats   request and byte counters since the last reset; prefix_bytes counts prompt
+                  bytes shared with an earlier prompt (what a server-side prefix cache could reuse)
+  POST /__reset   zero the counters
+  POST /__config  update latency/token_rate/error_rate/rate_limit/retry_after at runtime
+
+Usage: python3 bench/mock_llm.py --port 18080 --latency 50 --token-rate 200
+"""
+import argparse
+import json
+import os
+import random
+import re
+import sys
+import threading
+import time
+from http.server import BaseHTTPRequestHandler, ThreadingHTTPServer
+
+# Programs the default responder returns, by the language name glupe puts in its prompts
+PROGRAMS = {
+    "C++": ("//", '#include <iostream>\n\nint main() {\n    std::cout << "mock" << std::endl;\n    return 0;\n}\n'),
+    "C": ("//", '#include <stdio.h>\n\nint main(void) {\n    puts("mock");\n    return 0;\n}\n'),
+    "Rust": ("//", 'fn main() {\n    println!("mock");\n}\n'),
+    "Go": ("//", 'package main\n\nimport "fmt"\n\nfunc main() {\n    fmt.Println("mock")\n}\n'),
+    "JavaScript": ("//", 'console.log("mock");\n'),
+    "TypeScript": ("//", 'console.log("mock");\n'),
+    "Java": ("//", 'public class Main {\n    public static void main(String[] args) {\n        System.out.println("mock");\n    }\n}\n'),
+    "Python": ("#", 'def main():\n    print("mock")\n\n\nif __name__ == "__main__":\n    main()\n'),
+    "Ruby": ("#", 'puts "mock"\n'),
+    "Bash": ("#", 'echo mock\n'),
+}
+
+BLOCK_RE = re.compile(r"^// GLUPE_BLOCK_START: (.+?)\s*$", re.M)  # Marker lines, not the rule that explains them
+
+
+class MockState:
+    def __init__(self, args):
+        self.lock = threading.Lock()
+        self.latency = args.latency / 1000.0
+        self.token_rate = args.token_rate
+        self.error_rate = args.error_rate
+        self.rate_limit = args.rate_limit
+        self.retry_after = args.retry_after
+        self.model = args.model
+        self.random = random.Random(args.seed)
+        self.canned = load_canned(args.responses) if args.responses else []
+        self.reset()
+
+    def reset(self):
+        with self.lock:
+            self.stats = {"requests": 0, "bytes_in": 0, "bytes_out": 0, "errors_injected": 0,
+                          "rate_limited": 0, "cancelled": 0, "by_protocol": {}, "in_flight": 0, "max_in_flight": 0,
+                          "prompt_bytes": 0, "prefix_bytes": 0}
+            self.recent = []  # Last prompts, for prefix_bytes
+
+    def note_prompt(self, prompt):
+        with self.lock:
+            shared = max((len(os.path.commonprefix([prompt, p])) for p in self.recent), default=0)
+            self.stats["prompt_bytes"] += len(prompt)
+            self.stats["prefix_bytes"] += shared
+            self.recent = (self.recent + [prompt])[-32:]
+
+    def configure(self, cfg):
+        with self.lock:
+            if "latency" in cfg: self.latency = float(cfg["latency"]) / 1000.0
+            if "token_rate" in cfg: self.token_rate = float(cfg["token_rate"])
+            if "error_rate" in cfg: self.error_rate = float(cfg["error_rate"])
+            if "rate_limit" in cfg: self.rate_limit = float(cfg["rate_limit"])
+            if "retry_after" in cfg: self.retry_after = int(cfg["retry_after"])
+
+    def roll(self):
+        """Decides the fate of one request: None, 'error' or 'rate_limit'."""
+        with self.lock:
+            r = self.random.random()
+            if r < self.rate_limit:
+                self.stats["rate_limited"] += 1
+                return "rate_limit"
+            if r < self.rate_limit + self.error_rate:
+                self.stats["errors_injected"] += 1
+                return "error"
+            return None
+
+
+def load_canned(path):
+    """[{"match": "substring", "response": "text"}, ...] or {"substring": "text", ...}; first match wins.
+
+    An entry with "seed": n only answers requests sampled with that seed (glupe -speculate)."""
+    with open(path, encoding="utf-8") as f:
+        data = json.load(f)
+    if isinstance(data, dict):
+        data = [{"match": k, "response": v} for k, v in data.items()]
+    return [(entry.get("match", ""), entry.get("seed"), entry["response"]) for entry in data]
+
+
+def request_seed(req):
+    """The sampling seed of a request in any of the three shapes, or None."""
+    for holder in (req.get("options"), req, req.get("generationConfig")):
+        if isinstance(holder, dict) and "seed" in holder:
+            return holder["seed"]
+    return None
+
+
+def target_language(prompt):
+    for pattern in (r"single valid (.+?) file", r"LANGUAGE: (.+)", r"Generate a valid (.+?) file"):
+        m = re.search(pattern, prompt)
+        if m:
+            return m.group(1).strip()
+    return "C++"
+
+
+def with_blocks(prompt, lang):
+    """The default program, preceded by every GLUPE_BLOCK marker pair the prompt asked to keep."""
+    comment, body = PROGRAMS.get(lang, PROGRAMS["C++"])
+    if comment != "//":
+        return body  # The markers are C-style comments; other languages cannot carry them
+    blocks = ""
+    for block_id in dict.fromkeys(BLOCK_RE.findall(prompt)):
+        blocks += "// GLUPE_BLOCK_START: %s\n// mock implementation of %s\n// GLUPE_BLOCK_END: %s\n" % (block_id, block_id, block_id)
+    return blocks + body
+
+
+def default_response(prompt):
+    if prompt.startswith("ROLE: Senior Code Optimizer"):
+        return prompt.split("CODE:\n", 1)[1].rstrip("\n") if "CODE:\n" in prompt else ""
+    if "semantic blueprint" in prompt:
+        part = re.findall(r"\[SOURCE_CODE_PART_(\d+)\]", prompt)
+        n = part[-1] if part else "1"
+        return "$$ mock_part_%s {\n    1. Preserve the behaviour of source part %s.\n}$$\n" % (n, n)
+    if prompt.startswith("ROLE: Code Generator"):
+        ids = re.findall(r"container '([^']+)'", prompt)
+        comment = PROGRAMS.get(target_language(prompt), PROGRAMS["C++"])[0]
+        return "%s mock implementation of %s\n" % (comment, ids[-1] if ids else "container")
+    if prompt.startswith("ROLE: Code Repair"):
+        ids = re.findall(r"Container '([^']+)'", prompt)
+        comment = PROGRAMS.get(target_language(prompt), PROGRAMS["C++"])[0]
+        return "%s mock repair of %s\n" % (comment, ids[-1] if ids else "container")
+    if "'EXPORT: \"filename.ext\"'" in prompt:
+        return 'EXPORT: "mock_main.cpp"\n%sEXPORT: END\n' % with_blocks(prompt, "C++")
+    m = re.search(r"TASK: Implement the file '([^']+)'", prompt)
+    if m:
+        ext = m.group(1).rsplit(".", 1)[-1].lower()
+        lang = {"py": "Python", "c": "C", "rs": "Rust", "go": "Go", "js": "JavaScript", "sh": "Bash"}.get(ext, "C++")
+        return with_blocks(prompt, lang)
+    if prompt.startswith("ROLE: Expert") and "TASK: Fix the code" in prompt:
+        return prompt.split("CODE:\n", 1)[1].rsplit("\nOUTPUT:", 1)[0] if "CODE:\n" in prompt else ""
+    if "Semantic Transpiler" in prompt or "Software Architect" in prompt:
+        return with_blocks(prompt, target_language(prompt))
+    return "OK"
+
+
+def make_handler(state):
+    class Handler(BaseHTTPRequestHandler):
+        protocol_version = "HTTP/1.1"
+
+        def log_message(self, *args):
+            pass
+
+        def send_json(self, status, obj, extra_headers=None):
+            body = json.dumps(obj).encode("utf-8")
+            self.send_response(status)
+            self.send_header("Content-Type", "application/json")
+            self.send_header("Content-Length", str(len(body)))
+            for k, v in (extra_headers or {}).items():
+                self.send_header(k, v)
+            self.end_headers()
+            self.wfile.write(body)
+            return len(body)
+
+        def do_GET(self):
+            if self.path.startswith("/__stats"):
+                with state.lock:
+                    self.send_json(200, state.stats)
+            elif self.path.startswith("/api/tags"):
+                self.send_json(200, {"models": [{"name": state.model}]})
+            else:
+                self.send_json(404, {"error": {"message": "not found: " + self.path}})
+
+        def do_POST(self):
+            length = int(self.headers.get("Content-Length", 0))
+            raw = self.rfile.read(length) if length else b""
+            if self.path.startswith("/__reset"):
+                state.reset()
+                return self.send_json(200, {"ok": True})
+            if self.path.startswith("/__config"):
+                state.configure(json.loads(raw or b"{}"))
+                return self.send_json(200, {"ok": True})
+
+            if self.path.startswith("/api/generate"):
+                protocol = "ollama"
+            elif "/chat/completions" in self.path:
+                protocol = "openai"
+            elif ":generateContent" in self.path or ":streamGenerateContent" in self.path:
+                protocol = "google"
+            else:
+                return self.send_json(404, {"error": {"message": "not found: " + self.path}})
+
+            with state.lock:
+                st = state.stats
+                st["requests"] += 1
+                st["bytes_in"] += len(raw)
+                st["by_protocol"][protocol] = st["by_protocol"].get(protocol, 0) + 1
+                st["in_flight"] += 1
+                st["max_in_flight"] = max(st["max_in_flight"], st["in_flight"])
+            try:
+                sent = self.answer(protocol, raw)
+            finally:
+                with state.lock:
+                    state.stats["in_flight"] -= 1
+            with state.lock:
+                state.stats["bytes_out"] += sent
+
+        def answer(self, protocol, raw):
+            try:
+                req = json.loads(raw)
+                if protocol == "ollama":
+                    prompt = req["prompt"]
+                elif protocol == "openai":
+                    prompt = req["messages"][-1]["content"] if "messages" in req else req.get("message", "")
+                else:
+                    prompt = req["contents"][0]["parts"][0]["text"]
+            except (ValueError, KeyError, IndexError, TypeError) as e:
+                return self.send_json(400, {"error": {"message": "bad request body: %s" % e}})
+
+            state.note_prompt(prompt)
+            time.sleep(state.latency)
+            fate = state.roll()
+            if fate == "rate_limit":
+                msg = "Rate limit exceeded, please wait %d seconds" % state.retry_after
+                return self.send_json(429, {"error": {"message": msg}}, {"Retry-After": str(state.retry_after)})
+            if fate == "error":
+                return self.send_json(500, {"error": {"message": "mock injected failure"}})
+
+            seed = request_seed(req)
+            text = next((resp for match, want, resp in state.canned if match in prompt and want in (None, seed)), None)
+            if text is None:
+                text = default_response(prompt)
+            if ":streamGenerateContent" in self.path or (protocol != "google" and req.get("stream") is True):
+                return self.stream(protocol, text)
+            if state.token_rate > 0:
+                time.sleep((len(text) / 4.0) / state.token_rate)
+
+            if protocol == "ollama":
+                return self.send_json(200, {"model": state.model, "response": text, "done": True})
+            if protocol == "openai":
+                return self.send_json(200, {"choices": [{"index": 0, "message": {"role": "assistant", "content": text}, "finish_reason": "stop"}]})
+            return self.send_json(200, {"candidates": [{"content": {"parts": [{"text": text}], "role": "model"}}]})
+
+        def stream(self, protocol, text):
+            """Chunked response, one event per ~4 tokens, paced by --token-rate."""
+            self.send_response(200)
+            self.send_header("Content-Type", "application/x-ndjson" if protocol == "ollama" else "text/event-stream")
+            self.send_header("Transfer-Encoding", "chunked")
+            self.end_headers()
+            sent = 0
+            piece_len = 16
+            try:
+                sent += self.stream_events(protocol, text, piece_len)
+            except (BrokenPipeError, ConnectionResetError):
+                with state.lock:
+                    state.stats["cancelled"] += 1  # The client aborted the generation
+                self.close_connection = True
+            return sent
+
+        def stream_events(self, protocol, text, piece_len):
+            sent = 0
+            for i in range(0, len(text), piece_len):
+                piece = text[i:i + piece_len]
+                if protocol == "ollama":
+                    event = json.dumps({"model": state.model, "response": piece, "done": False}) + "\n"
+                elif protocol == "openai":
+                    event = "data: " + json.dumps({"choices": [{"index": 0, "delta": {"content": piece}}]}) + "\n\n"
+                else:
+                    event = "data: " + json.dumps({"candidates": [{"content": {"parts": [{"text": piece}], "role": "model"}}]}) + "\n\n"
+                sent += self.write_chunk(event.encode("utf-8"))
+                if state.token_rate > 0:
+                    time.sleep((len(piece) / 4.0) / state.token_rate)
+            if protocol == "ollama":
+                sent += self.write_chunk((json.dumps({"model": state.model, "response": "", "done": True}) + "\n").encode("utf-8"))
+            elif protocol == "openai":
+                sent += self.write_chunk(b"data: [DONE]\n\n")
+            self.wfile.write(b"0\r\n\r\n")
+            return sent
+
+        def write_chunk(self, data):
+            self.wfile.write(b"%x\r\n%s\r\n" % (len(data), data))
+            self.wfile.flush()
+            return len(data)
+
+    return Handler
+
+
+def main():
+    ap = argparse.ArgumentParser(description=__doc__.split("\n")[0])
+    ap.add_argument("--host", default="127.0.0.1")
+    ap.add_argument("--port", type=int, default=18080, help="0 picks a free port (printed on stdout)")
+    ap.add_argument("--latency", type=float, default=0.0, help="ms before each answer")
+    ap.add_argument("--token-rate", type=float, default=0.0, help="tokens/s of generated text (0 = instant)")
+    ap.add_argument("--error-rate", type=float, default=0.0, help="fraction of requests answered with HTTP 500")
+    ap.add_argument("--rate-limit", type=float, default=0.0, help="fraction of requests answered with HTTP 429")
+    ap.add_argument("--retry-after", type=int, default=1, help="seconds sent in Retry-After on 429")
+    ap.add_argument("--responses", help="JSON file with canned responses")
+    ap.add_argument("--model", default="mock")
+    ap.add_argument("--seed", type=int, default=1)
+    args = ap.parse_args()
+
+    server = ThreadingHTTPServer((args.host, args.port), make_handler(MockState(args)))
+    server.daemon_threads = True
+    print("mock_llm listening on http://%s:%d" % (args.host, server.server_address[1]), flush=True)
+    try:
+        server.serve_forever()
+    except KeyboardInterrupt:
+        pass
+
+
+if __name__ == "__main__":
+    sys.exit(main())
@@ -0,0 +1,263 @@
+#!/usr/bin/env python3
+"""End-to-end benchmark: runs glupe over the bundled corpora against bench/mock_llm.py.
+
+Every `.glp` file under the corpora is built (target language from its inner extension,
+e.g. `spaghetti.cpp.glp` -> -cpp), and every plain source file under refine-samples/ is
+refined with -refine. Each run happens in a throwaway copy of the file's directory with
+its own config.json and GLUPE_CACHE_DIR, so the repository is never written to and every
+run starts cold (use --warm to keep the cache between runs of a case).
+
+Reported per case (median over --runs): wall time, glupe overhead (wall minus time spent
+waiting on the LLM), the -crono phase breakdown, LLM requests and bytes as seen by the mock,
+and pfx%: the share of prompt bytes that repeat the start of an earlier prompt (what a server
+with prefix caching would not have to recompute).
+
+  python3 bench/run_bench.py --runs 3 --json out.json
+  python3 bench/run_bench.py --baseline out.json          # exit 1 on regressions
+"""
+import argparse
+import json
+import os
+import re
+import shutil
+import socket
+import statistics
+import subprocess
+import sys
+import tempfile
+import time
+import urllib.request
+
+HERE = os.path.dirname(os.path.abspath(__file__))
+ROOT = os.path.dirname(HERE)
+
+LANG_FLAGS = {"cpp": "cpp", "cc": "cpp", "c": "c", "py": "py", "rs": "rust", "go": "go", "js": "js"}
+REFINE_EXTS = {".cpp", ".cc", ".c", ".py", ".js", ".go", ".rs", ".cbl"}
+
+CRONO_TOTAL = re.compile(r"^\[CRONO\] Total: ([\d.]+)s")
+CRONO_PHASE = re.compile(r"^\s+\[CRONO\] ([\w-]+): ([\d.]+)s")
+CRONO_LLM = re.compile(r"\[CRONO\] LLM: (\d+) request\(s\), (?:\d+ aborted, )?([\d.]+)s waiting, (\d+) B sent, (\d+) B received")
+
+
+def discover(corpora, name_filter):
+    cases = []
+    for corpus in corpora:
+        base = os.path.join(ROOT, corpus)
+        for dirpath, _, files in sorted(os.walk(base)):
+            for f in sorted(files):
+                path = os.path.join(dirpath, f)
+                rel = os.path.relpath(path, ROOT)
+                if f.endswith(".glp"):
+                    inner = os.path.splitext(f[:-4])[1].lstrip(".").lower()
+                    case = {"name": rel, "file": path, "args": ["-" + LANG_FLAGS.get(inner, "cpp")]}
+                elif corpus.rstrip("/").endswith("refine-samples") and os.path.splitext(f)[1] in REFINE_EXTS:
+                    case = {"name": rel + " (refine)", "file": path, "args": ["-refine"]}
+                else:
+                    continue
+                if not name_filter or name_filter in case["name"]:
+                    cases.append(case)
+    return cases
+
+
+def free_port():
+    with socket.socket() as s:
+        s.bind(("127.0.0.1", 0))
+        return s.getsockname()[1]
+
+
+class Mock:
+    def __init__(self, args):
+        self.port = free_port()
+        cmd = [sys.executable, os.path.join(HERE, "mock_llm.py"), "--port", str(self.port),
+               "--latency", str(args.latency), "--token-rate", str(args.token_rate),
+               "--error-rate", str(args.error_rate), "--rate-limit", str(args.rate_limit),
+               "--retry-after", str(args.retry_after)]
+        if args.responses:
+            cmd += ["--responses", args.responses]
+        self.proc = subprocess.Popen(cmd, stdout=subprocess.PIPE, stderr=subprocess.DEVNULL, text=True)
+        self.proc.stdout.readline()  # "listening on ..."
+        self.base = "http://127.0.0.1:%d" % self.port
+
+    def call(self, path, method="GET"):
+        req = urllib.request.Request(self.base + path, data=b"{}" if method == "POST" else None, method=method)
+        with urllib.request.urlopen(req, timeout=10) as r:
+            return json.loads(r.read())
+
+    def config(self, protocol):
+        url = {"ollama": "/api/generate", "openai": "/v1/chat/completions",
+               "google": "/v1beta/models/mock:generateContent"}[protocol]
+        profile = {"protocol": protocol, "model_id": "mock", "api_url": self.base + url, "api_key": "mock"}
+        return {"local": profile, "cloud": profile, "max_retries": 3}
+
+    def stop(self):
+        self.proc.terminate()
+        self.proc.wait()
+
+
+def run_case(case, mock, args, workdir):
+    if not os.path.isdir(workdir):
+        shutil.copytree(os.path.dirname(case["file"]), workdir)
+        with open(os.path.join(workdir, "config.json"), "w") as f:
+            json.dump(mock.config(args.protocol), f)
+
+    env = dict(os.environ, GLUPE_CACHE_DIR=os.path.join(workdir, "glupe_cache"))
+    env.pop("GLUPE_LLM_CACHE", None)
+    cmd = [os.path.abspath(args.glupe), os.path.basename(case["file"])] + case["args"] + ["-crono", "-local"]
+    if args.jobs > 1:
+        cmd += ["-j", str(args.jobs)]
+    if args.speculate > 1:
+        cmd += ["-speculate", str(args.speculate)]
+    if args.stream:
+        cmd.append("-stream")
+
+    mock.call("/__reset", "POST")
+    start = time.perf_counter()
+    try:
+        proc = subprocess.run(cmd, cwd=workdir, env=env, stdin=subprocess.DEVNULL,
+                              stdout=subprocess.PIPE, stderr=subprocess.STDOUT, text=True,
+                              errors="replace", timeout=args.timeout)
+        output, code = proc.stdout, proc.returncode
+    except subprocess.TimeoutExpired as e:
+        output = e.stdout.decode("utf-8", "replace") if isinstance(e.stdout, bytes) else (e.stdout or "")
+        code = "timeout"
+    wall = time.perf_counter() - start
+    server = mock.call("/__stats")
+
+    run = {"wall": wall, "exit": code, "phases": {}, "llm_wait": None,
+           "requests": server["requests"], "bytes_sent": server["bytes_in"], "bytes_received": server["bytes_out"],
+           "prompt_bytes": server.get("prompt_bytes", 0), "prefix_bytes": server.get("prefix_bytes", 0)}
+    for line in output.splitlines():
+        m = CRONO_PHASE.match(line)
+        if m:
+            run["phases"][m.group(1)] = float(m.group(2))
+        m = CRONO_LLM.search(line)
+        if m:
+            run["llm_wait"] = float(m.group(2))
+    if args.verbose or code != 0:
+        tail = "\n".join(output.splitlines()[-15:])
+        print("   --- %s (exit %s) ---\n%s" % (case["name"], code, tail), file=sys.stderr)
+    return run
+
+
+def summarize(case, runs):
+    med = lambda xs: statistics.median(xs) if xs else 0.0
+    phases = {}
+    for r in runs:
+        for k in r["phases"]:
+            phases.setdefault(k, []).append(r["phases"][k])
+    overheads = [max(0.0, r["wall"] - r["llm_wait"]) for r in runs if r["llm_wait"] is not None]
+    return {
+        "name": case["name"],
+        "ok": all(r["exit"] == 0 for r in runs),
+        "wall": med([r["wall"] for r in runs]),
+        "overhead": med(overheads) if overheads else None,
+        "phases": {k: med(v) for k, v in phases.items()},
+        "requests": med([r["requests"] for r in runs]),
+        "bytes_sent": med([r["bytes_sent"] for r in runs]),
+        "bytes_received": med([r["bytes_received"] for r in runs]),
+        "prefix_share": med([r["prefix_bytes"] / r["prompt_bytes"] for r in runs if r["prompt_bytes"]]),
+        "runs": runs,
+    }
+
+
+def print_table(results):
+    fmt = "%-48s %5s %9s %9s %5s %10s %10s %5s  %s"
+    print(fmt % ("case", "ok", "wall(s)", "ovhd(s)", "req", "sent(B)", "recv(B)", "pfx%", "phases (s)"))
+    for r in results:
+        phases = " ".join("%s=%.3f" % (k, v) for k, v in r["phases"].items() if v >= 0.0005)
+        print(fmt % (r["name"][:48], "yes" if r["ok"] else "NO", "%.3f" % r["wall"],
+                     "-" if r["overhead"] is None else "%.3f" % r["overhead"], "%d" % r["requests"],
+                     "%d" % r["bytes_sent"], "%d" % r["bytes_received"], "%.0f" % (100 * r["prefix_share"]), phases))
+    print(fmt % ("TOTAL", "", "%.3f" % sum(r["wall"] for r in results),
+                 "%.3f" % sum(r["overhead"] or 0.0 for r in results), "%d" % sum(r["requests"] for r in results),
+                 "%d" % sum(r["bytes_sent"] for r in results), "%d" % sum(r["bytes_received"] for r in results), "", ""))
+
+
+def compare(results, baseline_path, threshold, floor):
+    with open(baseline_path) as f:
+        base = {r["name"]: r for r in json.load(f)["results"]}
+    regressions = []
+    print("\nAgainst baseline %s (threshold +%d%%, noise floor %.2fs):" % (baseline_path, threshold * 100, floor))
+    for r in results:
+        b = base.get(r["name"])
+        if not b:
+            continue
+        for metric in ("wall", "overhead", "requests", "bytes_sent"):
+            new, old = r.get(metric), b.get(metric)
+            if new is None or old is None:
+                continue
+            slack = floor if metric in ("wall", "overhead") else 0
+            if new > old * (1 + threshold) + slack:
+                regressions.append("%s: %s %.3f -> %.3f" % (r["name"], metric, old, new))
+    for line in regressions:
+        print("   [REGRESSION] " + line)
+    if not regressions:
+        print("   No regressions.")
+    return not regressions
+
+
+def main():
+    ap = argparse.ArgumentParser(description="glupe end-to-end benchmark against a local mock LLM")
+    ap.add_argument("--glupe", default=os.path.join(ROOT, "glupe"))
+    ap.add_argument("--corpus", nargs="+", default=["experiments", "refine-samples"])
+    ap.add_argument("--case", default="", help="only cases whose name contains this")
+    ap.add_argument("--runs", type=int, default=3)
+    ap.add_argument("--jobs", type=int, default=1, help="passed to glupe as -j")
+    ap.add_argument("--speculate", type=int, default=1, help="passed to glupe as -speculate")
+    ap.add_argument("--stream", action="store_true", help="run glupe with -stream")
+    ap.add_argument("--warm", action="store_true", help="keep glupe's caches between runs of a case")
+    ap.add_argument("--protocol", choices=["ollama", "openai", "google"], default="ollama")
+    ap.add_argument("--latency", type=float, default=20.0, help="mock ms per request")
+    ap.add_argument("--token-rate", type=float, default=0.0, help="mock tokens/s (0 = instant)")
+    ap.add_argument("--error-rate", type=float, default=0.0)
+    ap.add_argument("--rate-limit", type=float, default=0.0)
+    ap.add_argument("--retry-after", type=int, default=1)
+    ap.add_argument("--responses", help="canned responses file for the mock")
+    ap.add_argument("--timeout", type=float, default=300.0, help="seconds per glupe run")
+    ap.add_argument("--json", help="write results here (usable as a later --baseline)")
+    ap.add_argument("--baseline", help="results file from an earlier run to compare against")
+    ap.add_argument("--threshold", type=float, default=0.20, help="allowed relative slowdown")
+    ap.add_argument("--floor", type=float, default=0.05, help="absolute seconds ignored as noise")
+    ap.add_argument("--keep", action="store_true", help="keep the scratch directories")
+    ap.add_argument("-v", "--verbose", action="store_true", help="show the tail of every glupe run")
+    args = ap.parse_args()
+
+    if not os.path.exists(args.glupe):
+        sys.exit("ERROR: glupe binary not found at %s (run make first)" % args.glupe)
+    cases = discover(args.corpus, args.case)
+    if not cases:
+        sys.exit("ERROR: no benchmark cases found")
+
+    scratch = tempfile.mkdtemp(prefix="glupe_bench_")
+    mock = Mock(args)
+    results = []
+    try:
+        print("[BENCH] %d case(s) x %d run(s), mock %s (%s, %.0f ms latency)" %
+              (len(cases), args.runs, mock.base, args.protocol, args.latency))
+        for i, case in enumerate(cases):
+            runs = []
+            for n in range(args.runs):
+                workdir = os.path.join(scratch, "case%d" % i if args.warm else "case%d_run%d" % (i, n))
+                runs.append(run_case(case, mock, args, workdir))
+            results.append(summarize(case, runs))
+    finally:
+        mock.stop()
+        if args.keep:
+            print("[BENCH] Scratch kept at " + scratch)
+        else:
+            shutil.rmtree(scratch, ignore_errors=True)
+
+    print()
+    print_table(results)
+    if args.json:
+        with open(args.json, "w") as f:
+            json.dump({"glupe": args.glupe, "protocol": args.protocol, "latency_ms": args.latency,
+                       "runs": args.runs, "results": results}, f, indent=2)
+        print("\n[BENCH] Results written to " + args.json)
+    if args.baseline and not compare(results, args.baseline, args.threshold, args.floor):
+        return 1
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
@@ -74,7 +74,7 @@ if (-not (Test-Path $SrcDir)) {
 # 3. Download Source
 Write-Host "[INFO] Downloading source code..."
 try {
-    $SourceFiles = @("glupec.cpp", "common.hpp", "utils.hpp", "config.hpp", "languages.hpp", "ai.hpp", "cache.hpp", "parser.hpp", "processor.hpp", "hub.hpp")
+    $SourceFiles = @("glupec.cpp", "common.hpp", "utils.hpp", "config.hpp", "languages.hpp", "digest.hpp", "http.hpp", "balancer.hpp", "stream.hpp", "graph.hpp", "ai.hpp", "cache.hpp", "lexer.hpp", "parser.hpp", "shake.hpp", "processor.hpp", "verify.hpp", "hub.hpp")
     foreach ($file in $SourceFiles) {
         Invoke-WebRequest -Uri "$RepoUrl/src/$file" -OutFile "$SrcDir\$file"
     }
@@ -88,8 +88,16 @@ try {
 
 # 4. Compile
 Write-Host "[INFO] Compiling Glupe..."
+# Enable TLS for https:// endpoints when OpenSSL is available; otherwise they go through curl.
+$TlsFlags = ""
+$probeSrc = Join-Path $env:TEMP "glupe_tls_probe.cpp"
+Set-Content -Path $probeSrc -Value "#include <openssl/ssl.h>`nint main(){return OPENSSL_init_ssl(0,0)?0:1;}"
+& g++ $probeSrc -o (Join-Path $env:TEMP "glupe_tls_probe.exe") -static -lssl -lcrypto -lcrypt32 -lws2_32 2>$null
+if ($LASTEXITCODE -eq 0) { $TlsFlags = "-DGLUPE_TLS -lssl -lcrypto -lcrypt32" } else { Write-Host "[INFO] OpenSSL not found, https:// endpoints will go through curl." -ForegroundColor Yellow }
+Remove-Item $probeSrc, (Join-Path $env:TEMP "glupe_tls_probe.exe") -ErrorAction SilentlyContinue
+
 # [FIX] Added -static to ensure the exe runs on any machine without DLLs
- $BuildCmd = "g++ `"$SrcDir\glupec.cpp`" -o `"$ExePath`" -std=c++17 -static -static-libgcc -static-libstdc++ -lstdc++fs -O3 -I `"$SrcDir`""
+ $BuildCmd = "g++ `"$SrcDir\glupec.cpp`" -o `"$ExePath`" -std=c++17 -static -static-libgcc -static-libstdc++ -lstdc++fs $TlsFlags -lws2_32 -O3 -I `"$SrcDir`""
 Invoke-Expression $BuildCmd
 
 if (-not (Test-Path $ExePath)) {
@@ -58,7 +58,7 @@ echo -e "${GREEN}[OK] Created installation directory: $INSTALL_DIR${NC}"
 
 # 4. Download Source
 echo "[INFO] Downloading source code..."
-SOURCE_FILES="glupec.cpp common.hpp utils.hpp config.hpp languages.hpp ai.hpp cache.hpp parser.hpp processor.hpp hub.hpp"
+SOURCE_FILES="glupec.cpp common.hpp utils.hpp config.hpp languages.hpp digest.hpp http.hpp balancer.hpp stream.hpp graph.hpp ai.hpp cache.hpp lexer.hpp parser.hpp shake.hpp processor.hpp verify.hpp hub.hpp"
 for file in $SOURCE_FILES; do
     if ! curl -fsSL "$REPO_URL/src/$file" -o "$INSTALL_DIR/src/$file"; then
         echo -e "${RED}[ERROR] Failed to download $file${NC}"; exit 1
@@ -79,6 +79,18 @@ if [[ "$OSTYPE" == "linux-gnu"* ]]; then
     COMPILE_CMD="$COMPILE_CMD -lstdc++fs"
 fi
 
+# Enable TLS for https:// endpoints when OpenSSL is available; otherwise they go through curl.
+if printf '#include <openssl/ssl.h>\nint main(){return OPENSSL_init_ssl(0,0)?0:1;}\n' \
+    | $COMPILER -x c++ - -o /dev/null -lssl -lcrypto >/dev/null 2>&1; then
+    COMPILE_CMD="$COMPILE_CMD -DGLUPE_TLS -lssl -lcrypto"
+    echo -e "${GREEN}[OK] OpenSSL found, https:// endpoints use the built-in client.${NC}"
+else
+    echo -e "${YELLOW}[INFO] OpenSSL not found, https:// endpoints will go through curl.${NC}"
+    echo "  Ubuntu/Debian: sudo apt install libssl-dev"
+    echo "  Fedora: sudo dnf install openssl-devel"
+    echo "  macOS: brew install openssl"
+fi
+
 eval $COMPILE_CMD
 
 if [ ! -f "$EXE_PATH" ]; then
@@ -1,66 +1,258 @@
 #pragma once
 #include "config.hpp"
+#include "http.hpp"
+#include "balancer.hpp"
+#include "cache.hpp"
+#include "stream.hpp"
+
+// --- LLM RESPONSE CACHE ---
+// Raw API responses keyed by digest(protocol, model, endpoint, prompt), in the same
+// content-addressed store as containers. Behaviour follows LLM_CACHE_MODE (config.hpp).
+inline atomic<int> LLM_CACHE_HITS{0};
+inline atomic<int> LLM_CACHE_MISSES{0};
+inline const string LLM_REPLAY_MISS = "ERROR: LLM cache miss in replay mode";
+inline const string STREAM_ABORTED = "ERROR: Generation aborted";
+inline atomic<int> STREAM_ABORTS{0};
+
+inline string llmCacheKey(const string& prompt, int variant = 0) {
+    Sha256 h;
+    h.field("glupe-llm-v1").field(PROTOCOL).field(MODEL_ID).field(API_URL).field(prompt);
+    if (variant > 0) h.field("variant").field(to_string(variant));
+    return h.hex();
+}
+
+// Errors that retrying cannot fix (callers stop their retry loops on these)
+inline bool isPermanentAIError(const string& err) {
+    return err.rfind(LLM_REPLAY_MISS, 0) == 0;
+}
+
+// A StreamCheck cancelled the answer mid-generation; retry straight away (no backoff)
+inline bool isStreamAbort(const string& err) {
+    return err.rfind(STREAM_ABORTED, 0) == 0;
+}
+
+inline string extractCode(string jsonResponse);
+
+// --- LLM TRAFFIC (reported by -crono) ---
+// Counted per HTTP request, so transport-level retries show up; cache hits send nothing.
+inline atomic<int> LLM_REQUESTS{0};
+inline atomic<long long> LLM_BYTES_SENT{0};
+inline atomic<long long> LLM_BYTES_RECEIVED{0};
+inline atomic<long long> LLM_WAIT_US{0};
+
+inline string llmTrafficSummary() {
+    stringstream ss;
+    ss << "LLM: " << LLM_REQUESTS << " request(s), " << STREAM_ABORTS << " aborted, " << fixed << setprecision(3) << LLM_WAIT_US / 1e6 << "s waiting, "
+       << LLM_BYTES_SENT << " B sent, " << LLM_BYTES_RECEIVED << " B received, " << LLM_CACHE_HITS << " cache hit(s)";
+    string pool = LLM_POOL.summary();
+    if (!pool.empty()) ss << "\n   [CRONO] " << pool;
+    return ss.str();
+}
 
 // --- AI CORE ---
-inline string callAI(string prompt) {
-    string response;
-    string url = API_URL;
-    
-    json body;
-    string extraHeaders = "";
-
-    if (PROTOCOL == "google") {
-        body["contents"][0]["parts"][0]["text"] = prompt;
-        if (url.find("?key=") == string::npos) url += "?key=" + API_KEY;
-    } 
-    else if (PROTOCOL == "openai") {
-        body["model"] = MODEL_ID;
-        
-        // [FIX] Handle APIFreeLLM divergence 
-        if (API_URL.find("apifreellm.com") != string::npos) {
-            body["message"] = prompt; 
-        } else {
-            body["messages"][0]["role"] = "user";
-            body["messages"][0]["content"] = prompt;
+// With STREAM_MODE the answer is read as it is generated and `onCode` sees the extracted code grow
+// (downstream checks can start on partial output). Streamed answers are returned normalized to
+// {"response": text}, so extractCode and the LLM cache treat them like any other response.
+// Without streaming (or on a cache hit) `onCode` is called once with the final code.
+// A `check` forces streaming and is fed the same partial code; when it reports a violation the
+// request is cancelled and STREAM_ABORTED + reason is returned (never cached).
+// Requests are scheduled over the endpoint pool (balancer.hpp) at `priority`. A node that fails
+// is skipped for the rest of the call, so the same prompt fails over to the next node before an
+// error is returned; a 429 throttles the node and puts the request back in the queue.
+// `variant` > 0 asks for a differently sampled answer (own temperature and seed), for speculative
+// candidates; 0 leaves sampling to the server.
+inline string callAI(string prompt, const CodeStreamHook& onCode = nullptr, const StreamCheck& check = nullptr, int priority = LLM_PRIORITY_NORMAL, int variant = 0) {
+    string cacheKey;
+    if (LLM_CACHE_MODE != "off") {
+        cacheKey = llmCacheKey(prompt, variant);
+        if (LLM_CACHE_MODE != "record") {
+            string cached = getCachedContent(cacheKey);
+            if (!cached.empty()) {
+                LLM_CACHE_HITS++;
+                if (VERBOSE_MODE) log("LLM_CACHE", "hit " + cacheKey.substr(0, 12));
+                if (onCode) onCode(extractCode(cached), 0);
+                return cached;
+            }
+            LLM_CACHE_MISSES++;
+            if (LLM_CACHE_MODE == "replay") {
+                log("LLM_CACHE", "replay miss " + cacheKey.substr(0, 12));
+                return LLM_REPLAY_MISS + " (" + cacheKey.substr(0, 12) + "). Record it first with -llm-cache record.";
+            }
         }
-        
-        extraHeaders = " -H \"Authorization: Bearer " + API_KEY + "\"";
-    }
-    else { 
-        body["model"] = MODEL_ID;
-        body["prompt"] = prompt;
-        body["stream"] = false; 
     }
 
-    for(int i=0; i<3; i++) {
-        ofstream file("request_temp.json"); 
-        file << body.dump(-1, ' ', false, json::error_handler_t::replace); 
-        file.close();
-        
-        string verbosity = VERBOSE_MODE ? " -v" : " -s";
-        string cmd = "curl" + verbosity + " -X POST -H \"Content-Type: application/json\"" + extraHeaders + " -d @request_temp.json \"" + url + "\"";
-        
-        CmdResult res = execCmd(cmd);
-        response = res.output;
-        remove("request_temp.json");
+    LLM_POOL.sync();
+    bool stream = (STREAM_MODE || check) && API_URL.find("apifreellm.com") == string::npos;
+    HttpHeaders headers = { {"Content-Type", "application/json"} };
+    if (PROTOCOL == "openai") headers.push_back({"Authorization", "Bearer " + API_KEY});
+
+    // URL and body for one endpoint of the pool (nodes may serve the model under another name)
+    auto buildRequest = [&](const LlmEndpoint& ep, string& url, string& payload) {
+        string model = ep.model.empty() ? MODEL_ID : ep.model;
+        url = ep.url;
+        json body;
+        if (PROTOCOL == "google") {
+            body["contents"][0]["parts"][0]["text"] = prompt;
+            if (url.find("?key=") == string::npos) url += "?key=" + API_KEY;
+            if (stream) {
+                size_t method = url.find(":generateContent");
+                if (method != string::npos) url.replace(method, 16, ":streamGenerateContent");
+                url += "&alt=sse";
+            }
+        } 
+        else if (PROTOCOL == "openai") {
+            body["model"] = model;
+            
+            // [FIX] Handle APIFreeLLM divergence 
+            if (url.find("apifreellm.com") != string::npos) {
+                body["message"] = prompt; 
+            } else {
+                body["messages"][0]["role"] = "user";
+                body["messages"][0]["content"] = prompt;
+            }
+            if (stream) body["stream"] = true;
+        }
+        else { 
+            body["model"] = model;
+            body["prompt"] = prompt;
+            body["stream"] = stream;
+            if (!OLLAMA_KEEP_ALIVE.is_null() && OLLAMA_KEEP_ALIVE != "") body["keep_alive"] = OLLAMA_KEEP_ALIVE;
+        }
+        if (variant > 0) {
+            double temperature = min(1.0, 0.2 + 0.3 * variant);
+            if (PROTOCOL == "google") {
+                body["generationConfig"]["temperature"] = temperature;
+                body["generationConfig"]["seed"] = variant;
+            } else if (PROTOCOL == "openai") {
+                body["temperature"] = temperature;
+                body["seed"] = variant;
+            } else {
+                body["options"]["temperature"] = temperature;
+                body["options"]["seed"] = variant;
+            }
+        }
+        // Serialized once per attempt; the transport writes it straight to the socket (no temp file, no shell)
+        payload = body.dump(-1, ' ', false, json::error_handler_t::replace);
+    };
+
+    HttpResponse res;
+    bool streamed = false;
+    set<int> tried; // Nodes that failed during this call
+    long long ticket = 0; // Place in the scheduler queue, kept when a 429 sends the request back
+    int rateLimited = 0;
+    double promptTokens = estimateTokens(prompt.size());
+    while (true) {
+        int node = LLM_POOL.acquire(tried, promptTokens, priority, ticket);
+        if (node < 0) break;
+        LlmEndpoint ep = LLM_POOL.endpoint(node);
+        string url, payload;
+        buildRequest(ep, url, payload);
+        HttpTransport& transport = transportFor(url);
+        streamed = false;
+
+        auto sent = chrono::steady_clock::now();
+        if (stream) {
+            LlmStreamDecoder decoder(PROTOCOL);
+            StreamingCodeExtractor extractor;
+            string violation;
+            extractor.onCode = [&](const string& code, size_t from) {
+                if (onCode) onCode(code, from);
+                if (check && violation.empty()) violation = check(code, from);
+            };
+            res = transport.postStreaming(url, headers, payload, [&](const char* data, size_t len) {
+                extractor.feed(decoder.feed(data, len));
+                return violation.empty();
+            });
+            if (res.cancelled && !violation.empty()) {
+                LLM_POOL.release(node, true, -1); // The answer was wrong, not the server
+                LLM_REQUESTS++;
+                STREAM_ABORTS++;
+                LLM_BYTES_SENT += (long long)payload.size();
+                LLM_BYTES_RECEIVED += (long long)res.body.size();
+                LLM_WAIT_US += chrono::duration_cast<chrono::microseconds>(chrono::steady_clock::now() - sent).count();
+                log("STREAM", "Aborted after " + to_string(extractor.code.size()) + " bytes of code: " + violation);
+                return STREAM_ABORTED + ": " + violation;
+            }
+            extractor.feed(decoder.finish());
+            // A server that ignored "stream" answered with a plain body; leave it for extractCode
+            streamed = res.error.empty() && res.status >= 200 && res.status < 300 && decoder.events;
+            if (streamed) {
+                LLM_BYTES_RECEIVED += (long long)res.body.size();
+                json normalized;
+                if (decoder.error.empty()) normalized["response"] = decoder.text;
+                else normalized["error"]["message"] = decoder.error;
+                res.body = normalized.dump(-1, ' ', false, json::error_handler_t::replace);
+                if (decoder.error.empty()) extractor.finish();
+            }
+        } else {
+            res = transport.post(url, headers, payload);
+        }
+        LLM_REQUESTS++;
+        LLM_BYTES_SENT += (long long)payload.size();
+        if (!streamed) LLM_BYTES_RECEIVED += (long long)res.body.size();
+        auto waited = chrono::duration_cast<chrono::microseconds>(chrono::steady_clock::now() - sent).count();
+        LLM_WAIT_US += waited;
+
+        bool failed = !res.error.empty() || res.status >= 500 || res.status == 404;
+        LLM_POOL.release(node, !failed, res.status == 429 ? -1 : waited / 1000.0, estimateTokens(res.body.size()));
         
-        if (VERBOSE_MODE) cout << "\n[DEBUG] Raw Response: " << response << endl;
+        if (VERBOSE_MODE) cout << "\n[DEBUG] HTTP " << res.status << " Raw Response: " << res.body << endl;
 
-        if (response.find("401 Unauthorized") != string::npos) return "ERROR: 401 Unauthorized (Check API Key)";
-        if (response.find("404 Not Found") != string::npos) return "ERROR: 404 Not Found (Check URL)";
+        if (res.status == 429) {
+            double wait = retryAfterHint(res.headers, res.body);
+            if (wait < 0) wait = llmBackoffSeconds(rateLimited);
+            LLM_POOL.throttle(node, wait);
+            stringstream msg;
+            msg << ep.url << " rate limited (429), throttled for " << fixed << setprecision(1) << wait << "s";
+            log("RATE_LIMIT", msg.str());
+            if (rateLimited++ < LlmBalancer::RATE_LIMIT_REQUEUES) continue;
+        }
 
-        if (response.find("Missing required parameter") != string::npos) {
-             cout << "\n[DEBUG] API rejected payload. Sending: " << body.dump() << endl;
+        if (failed) {
+            tried.insert(node);
+            if (tried.size() < LLM_POOL.size()) {
+                log("POOL", ep.url + " failed (" + (res.error.empty() ? "HTTP " + to_string(res.status) : res.error) + "), failing over");
+                continue;
+            }
         }
 
-        if (PROTOCOL == "google" && response.find("429") != string::npos) { 
-             log("WARN", "API 429 Rate Limit. Backoff...");
-             this_thread::sleep_for(chrono::seconds(5 * (i+1)));
-             continue; 
+        if (!res.error.empty()) return "ERROR: " + res.error;
+        if (res.status == 401) return "ERROR: 401 Unauthorized (Check API Key)";
+        if (res.status == 404) return "ERROR: 404 Not Found (Check URL)";
+
+        if (res.body.find("Missing required parameter") != string::npos) {
+             cout << "\n[DEBUG] API rejected payload. Sending: " << payload << endl;
         }
+
         break;
     }
-    return response;
+
+    // Only successful, well-formed answers are worth replaying
+    if (!cacheKey.empty() && res.status >= 200 && res.status < 300 && extractCode(res.body).rfind("ERROR:", 0) != 0) {
+        setCachedContent(cacheKey, res.body);
+    }
+    if (onCode && !streamed && res.status >= 200 && res.status < 300) {
+        string code = extractCode(res.body);
+        if (code.rfind("ERROR:", 0) != 0) onCode(code, 0);
+    }
+    return res.body;
+}
+
+// Console progress for streamed generations: a line every `every` lines of code received.
+// Returns an empty hook when streaming is off (the answer arrives all at once anyway).
+inline CodeStreamHook streamProgress(int every = 25) {
+    if (!STREAM_MODE) return nullptr;
+    auto lines = make_shared<size_t>(0);
+    auto shown = make_shared<size_t>(0);
+    return [=](const string& code, size_t from) {
+        if (from == 0) *lines = 0;
+        *lines += count(code.begin() + from, code.end(), '\n');
+        if (*lines >= *shown + every) {
+            *shown = *lines - *lines % every;
+            lock_guard<mutex> lock(LOG_MUTEX);
+            cout << "      [STREAM] " << *shown << " lines received..." << endl;
+        }
+    };
 }
 
 inline string extractCode(string jsonResponse) {
@@ -93,14 +285,7 @@ inline string extractCode(string jsonResponse) {
             return "ERROR: UNKNOWN_RESPONSE_FORMAT: " + jsonResponse.substr(0, 100);
         }
         
-        size_t start = raw.find("```"); 
-        if (start == string::npos) return raw; 
-        size_t end_line = raw.find('\n', start); 
-        size_t end_block = raw.rfind("```");
-        if (end_line != string::npos && end_block != string::npos && end_block > end_line) {
-            return raw.substr(end_line + 1, end_block - end_line - 1);
-        }
-        return raw;
+        return stripCodeFences(raw);
     } catch (const exception& e) { 
         string safeMsg = jsonResponse;
         if (safeMsg.length() > 200) safeMsg = safeMsg.substr(0, 200) + "...";
@@ -139,17 +324,16 @@ inline void selectOllamaModel() {
         } catch(...) {}
     }
 
-    string cmd = "curl -s \"" + url + "\"";
-    CmdResult res = execCmd(cmd);
+    HttpResponse res = transportFor(url).get(url);
 
-    if (res.exitCode != 0 || res.output.empty()) {
+    if (!res.error.empty() || res.body.empty()) {
         cout << "[ERROR] Could not connect to Ollama at " << url << endl;
         cout << "Make sure Ollama is running." << endl;
         return;
     }
 
     try {
-        json j = json::parse(res.output);
+        json j = json::parse(res.body);
         if (!j.contains("models")) { cout << "[ERROR] Unexpected response format." << endl; return; }
 
         vector<string> models;
@@ -0,0 +1,275 @@
+#pragma once
+#include "config.hpp"
+#include <condition_variable>
+#include <random>
+
+// --- LLM ENDPOINT POOL & REQUEST SCHEDULER ---
+// Every LLM request is scheduled here, over API_ENDPOINTS (or the single API_URL).
+//  - Routing: the node with the fewest requests in flight per unit of weight, scaled by its
+//    observed latency.
+//  - Limits: max_concurrency, and token buckets for requests/min (rpm) and tokens/min (tpm).
+//    Prompt tokens are charged up front; answer tokens are charged when the request ends.
+//  - Rate limits: a 429 throttles only that node until its Retry-After. The request goes back into
+//    the queue and keeps its place there.
+//  - Health (passive): a transport error, 5xx or 404 puts a node in cooldown (doubling per
+//    consecutive failure, capped) and callAI fails over to another node. A node in cooldown is
+//    only used again when every other candidate is down too, which doubles as its probe.
+// Waiting requests form one queue ordered by (priority, arrival). The first one that some node can
+// serve right now goes next, so a request stuck behind a throttled node does not hold up the rest.
+enum LlmPriority { LLM_PRIORITY_HIGH = 0, LLM_PRIORITY_NORMAL = 1, LLM_PRIORITY_LOW = 2 };
+
+// Rough token count (~4 bytes per token) used for tpm budgets
+inline double estimateTokens(size_t bytes) { return bytes / 4.0; }
+
+struct LlmNode {
+    LlmEndpoint ep;
+    int outstanding = 0;
+    int consecutiveFailures = 0;
+    double latencyMs = 0;   // EWMA over successful requests (0: no sample yet)
+    chrono::steady_clock::time_point downUntil;
+    chrono::steady_clock::time_point throttledUntil; // Retry-After of the last 429
+    double requestBucket = 0; // rpm tokens left
+    double tokenBucket = 0;   // tpm tokens left (negative: answer tokens still being paid off)
+    chrono::steady_clock::time_point refilled;
+    long long requests = 0;
+    long long failures = 0;
+    long long throttled = 0;
+};
+
+class LlmBalancer {
+public:
+    typedef chrono::steady_clock Clock;
+    static constexpr double COOLDOWN_BASE_S = 1.0;
+    static constexpr double COOLDOWN_MAX_S = 30.0;
+    static constexpr int RATE_LIMIT_REQUEUES = 5; // 429s one callAI waits out before giving up
+
+    // Rebuilds the pool when the configuration changed (loadConfig may run more than once)
+    void sync() {
+        vector<LlmEndpoint> eps = API_ENDPOINTS;
+        if (eps.empty()) eps.push_back({API_URL, "", 1, 0, API_RPM, API_TPM});
+        string sig;
+        for (const auto& e : eps) {
+            sig += e.url + '\n' + e.model + '\n' + to_string(e.weight) + '/' + to_string(e.maxConcurrency) + '/' + to_string(e.rpm) + '/' + to_string(e.tpm) + '\n';
+        }
+        lock_guard<mutex> lock(mtx);
+        if (sig == signature) return;
+        signature = sig;
+        nodes.clear();
+        for (auto& e : eps) {
+            LlmNode n;
+            n.ep = e;
+            n.requestBucket = e.rpm;
+            n.tokenBucket = e.tpm;
+            n.refilled = Clock::now();
+            nodes.push_back(n);
+        }
+    }
+
+    size_t size() {
+        lock_guard<mutex> lock(mtx);
+        return nodes.size();
+    }
+
+    // Leases a node that is not in `tried` for a request of `tokens` prompt tokens, waiting in the
+    // queue until one can take it. `ticket` keeps the request's place across calls (0: new
+    // request; it is assigned on the first call). Returns -1 when all nodes were tried.
+    int acquire(const set<int>& tried, double tokens, int priority, long long& ticket) {
+        unique_lock<mutex> lock(mtx);
+        if (ticket == 0) ticket = ++lastTicket;
+        pair<int, long long> key(priority, ticket);
+        queue[key] = {&tried, tokens};
+        while (true) {
+            auto now = Clock::now();
+            for (auto& n : nodes) refill(n, now);
+            auto wake = now + chrono::seconds(1);
+            int pick = -1;
+            bool ahead = false;
+            for (auto& [k, w] : queue) {
+                int candidates = 0;
+                int p = choose(*w.tried, w.tokens, now, candidates, wake);
+                if (k == key) {
+                    if (candidates == 0) { queue.erase(key); return -1; }
+                    pick = p;
+                    break;
+                }
+                if (p >= 0) { ahead = true; break; } // An earlier request goes first
+            }
+            if (pick >= 0) {
+                LlmNode& n = nodes[pick];
+                n.outstanding++;
+                n.requests++;
+                if (n.ep.rpm > 0) n.requestBucket -= 1;
+                if (n.ep.tpm > 0) n.tokenBucket -= min(tokens, (double)n.ep.tpm);
+                queue.erase(key);
+                freed.notify_all(); // Whoever is next in the queue may be servable as well
+                return pick;
+            }
+            if (ahead) freed.notify_all();
+            freed.wait_until(lock, wake);
+        }
+    }
+
+    LlmEndpoint endpoint(int i) {
+        lock_guard<mutex> lock(mtx);
+        return nodes[i].ep;
+    }
+
+    // Ends a lease. `ok == false` marks the node unhealthy for a while; `ms < 0` records no latency.
+    // `answerTokens` are charged to the node's tpm budget.
+    void release(int i, bool ok, double ms, double answerTokens = 0) {
+        {
+            lock_guard<mutex> lock(mtx);
+            LlmNode& n = nodes[i];
+            n.outstanding--;
+            if (n.ep.tpm > 0) n.tokenBucket -= answerTokens;
+            if (ok) {
+                n.consecutiveFailures = 0;
+                if (ms >= 0) n.latencyMs = (n.latencyMs == 0) ? ms : 0.8 * n.latencyMs + 0.2 * ms;
+            } else {
+                n.failures++;
+                n.consecutiveFailures++;
+                double cooldown = min(COOLDOWN_MAX_S, COOLDOWN_BASE_S * (1 << min(n.consecutiveFailures - 1, 5)));
+                n.downUntil = Clock::now() + chrono::milliseconds((long long)(cooldown * 1000));
+            }
+        }
+        freed.notify_all();
+    }
+
+    // The node answered 429: nothing more is sent to it for `seconds`
+    void throttle(int i, double seconds) {
+        lock_guard<mutex> lock(mtx);
+        LlmNode& n = nodes[i];
+        n.throttled++;
+        n.throttledUntil = max(n.throttledUntil, Clock::now() + chrono::milliseconds((long long)(seconds * 1000)));
+    }
+
+    // "Pool: url 12 req (1 failed, 2 throttled), ..." for -crono; empty for a single endpoint
+    string summary() {
+        lock_guard<mutex> lock(mtx);
+        if (nodes.size() < 2) return "";
+        stringstream ss;
+        ss << "Pool: ";
+        for (size_t i = 0; i < nodes.size(); i++) {
+            const LlmNode& n = nodes[i];
+            if (i) ss << ", ";
+            ss << n.ep.url << " " << n.requests << " req";
+            if (n.failures && n.throttled) ss << " (" << n.failures << " failed, " << n.throttled << " throttled)";
+            else if (n.failures) ss << " (" << n.failures << " failed)";
+            else if (n.throttled) ss << " (" << n.throttled << " throttled)";
+        }
+        return ss.str();
+    }
+
+private:
+    struct Waiter {
+        const set<int>* tried;
+        double tokens;
+    };
+
+    mutex mtx;
+    condition_variable freed;
+    vector<LlmNode> nodes;
+    string signature;
+    map<pair<int, long long>, Waiter> queue; // (priority, ticket) -> request
+    long long lastTicket = 0;
+
+    static void refill(LlmNode& n, Clock::time_point now) {
+        double elapsed = chrono::duration<double>(now - n.refilled).count();
+        n.refilled = now;
+        if (n.ep.rpm > 0) n.requestBucket = min((double)n.ep.rpm, n.requestBucket + elapsed * n.ep.rpm / 60.0);
+        if (n.ep.tpm > 0) n.tokenBucket = min((double)n.ep.tpm, n.tokenBucket + elapsed * n.ep.tpm / 60.0);
+    }
+
+    // Best node for a request right now, or -1. Counts the nodes it may still use in `candidates`
+    // and pulls `wake` in to the moment a limit that blocks it runs out.
+    int choose(const set<int>& tried, double tokens, Clock::time_point now, int& candidates, Clock::time_point& wake) const {
+        bool anyHealthy = false;
+        for (size_t i = 0; i < nodes.size(); i++) {
+            if (!tried.count((int)i) && nodes[i].downUntil <= now) anyHealthy = true;
+        }
+        double best = 0;
+        int pick = -1;
+        for (size_t i = 0; i < nodes.size(); i++) {
+            const LlmNode& n = nodes[i];
+            if (tried.count((int)i)) continue;
+            if (anyHealthy && n.downUntil > now) continue;
+            candidates++;
+            if (n.ep.maxConcurrency > 0 && n.outstanding >= n.ep.maxConcurrency) continue;
+            if (n.throttledUntil > now) { wake = min(wake, n.throttledUntil); continue; }
+            if (n.ep.rpm > 0 && n.requestBucket < 1) {
+                wake = min(wake, now + chrono::milliseconds((long long)((1 - n.requestBucket) * 60000.0 / n.ep.rpm) + 1));
+                continue;
+            }
+            double need = min(tokens, (double)n.ep.tpm);
+            if (n.ep.tpm > 0 && n.tokenBucket < need) {
+                wake = min(wake, now + chrono::milliseconds((long long)((need - n.tokenBucket) * 60000.0 / n.ep.tpm) + 1));
+                continue;
+            }
+            double score = (n.outstanding + 1) / (double)n.ep.weight * latencyFactor(n);
+            // All down: probe the one that recovers first
+            if (!anyHealthy) score = chrono::duration<double>(n.downUntil - now).count();
+            if (pick < 0 || score < best) { pick = (int)i; best = score; }
+        }
+        return pick;
+    }
+
+    // 1 for the fastest node, up to 4 for nodes that answer much slower; unmeasured nodes count as fast
+    double latencyFactor(const LlmNode& n) const {
+        if (n.latencyMs <= 0) return 1.0;
+        double fastest = 0;
+        for (const auto& o : nodes) {
+            if (o.latencyMs > 0 && (fastest == 0 || o.latencyMs < fastest)) fastest = o.latencyMs;
+        }
+        return min(4.0, max(1.0, n.latencyMs / fastest));
+    }
+};
+
+inline LlmBalancer LLM_POOL;
+
+// --- BACKOFF ---
+// Server hint for how long to wait, in seconds, or -1: a Retry-After header, Google's
+// "retryDelay": "20s", or "retry after 20s" / "try again in 20s" / "wait 20 seconds" in an error.
+inline double retryAfterHint(const map<string, string>& headers, const string& text) {
+    auto h = headers.find("retry-after");
+    if (h != headers.end()) {
+        try { return max(0.0, stod(h->second)); } catch (...) {} // HTTP-date form: use the backoff
+    }
+    string lower = text;
+    transform(lower.begin(), lower.end(), lower.begin(), ::tolower);
+    for (const char* marker : {"\"retrydelay\": \"", "\"retrydelay\":\"", "retry after ", "try again in ", "wait "}) {
+        size_t p = lower.find(marker);
+        if (p == string::npos) continue;
+        p += strlen(marker);
+        char* end = nullptr;
+        double v = strtod(lower.c_str() + p, &end);
+        if (end != lower.c_str() + p && v > 0) {
+            string unit = lower.substr(end - lower.c_str(), 3);
+            return unit.rfind("ms", 0) == 0 ? v / 1000.0 : v;
+        }
+    }
+    return -1;
+}
+
+// Jittered exponential backoff: 2s, 4s, 8s... capped at 60s, each drawn from [50%, 100%] so parallel
+// workers do not retry in lockstep. A server hint in `err` wins.
+inline double llmBackoffSeconds(int attempt, const string& err = "") {
+    double hint = retryAfterHint({}, err);
+    if (hint >= 0) return hint + 1; // The server's clock is not ours
+    static thread_local mt19937 rng(random_device{}());
+    double cap = min(60.0, 2.0 * (1 << min(attempt, 5)));
+    return uniform_real_distribution<double>(cap / 2, cap)(rng);
+}
+
+// The single wait of the retry loops around callAI (rate limits are already waited out per node
+// inside callAI; this covers other errors). Only the calling thread waits.
+inline void backoffBeforeRetry(int attempt, const string& err) {
+    double waitTime = llmBackoffSeconds(attempt, err);
+    stringstream msg;
+    msg << fixed << setprecision(1) << waitTime << "s...";
+    if (err.find("Rate limit") != string::npos || err.find("429") != string::npos) {
+        cout << "       -> Rate limit detected. Waiting " << msg.str() << endl;
+    } else {
+        cout << "       -> Retrying in " << msg.str() << endl;
+    }
+    this_thread::sleep_for(chrono::milliseconds((long long)(waitTime * 1000)));
+}
@@ -1,5 +1,13 @@
 #pragma once
-#include "common.hpp"
+#include "config.hpp"
+#include "digest.hpp"
+#ifdef _WIN32
+#include <io.h>
+#else
+#include <fcntl.h>
+#include <sys/file.h>
+#include <cerrno>
+#endif
 
 // [v6.0] Semantic Node Structure
 enum class NodeType {
@@ -25,23 +33,163 @@ struct SemanticNode {
 inline map<string, SemanticNode> SYMBOL_TABLE;
 
 // [NEW] Cache System Constants
-inline const string CACHE_DIR = "glupe_cache";
+// Content-addressed store; point GLUPE_CACHE_DIR at a shared path to dedupe across checkouts
+inline string CACHE_DIR = getenv("GLUPE_CACHE_DIR") ? getenv("GLUPE_CACHE_DIR") : "glupe_cache";
 inline const string LOCK_FILE = ".glupe.lock";
 
 inline json LOCK_DATA;
+inline json LOCK_BASE; // LOCK_DATA as last read from disk; saveCache() writes back only what differs
 
-inline void initCache() {
-    if (!fs::exists(CACHE_DIR)) fs::create_directory(CACHE_DIR);
+// --- CROSS-PROCESS LOCK ---
+// Several glupe runs may share a directory (make -j over .glp targets). Journal appends and
+// snapshot writes happen under an exclusive lock on .glupe.lock.lck, and saveCache() merges
+// this run's changes into whatever the others wrote meanwhile.
+struct LockfileMutex {
+    #ifdef _WIN32
+    HANDLE handle = INVALID_HANDLE_VALUE;
+    #else
+    int fd = -1;
+    #endif
+
+    void lock() {
+        #ifdef _WIN32
+        if (handle == INVALID_HANDLE_VALUE) {
+            handle = CreateFileA(".glupe.lock.lck", GENERIC_READ | GENERIC_WRITE, FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE, nullptr, OPEN_ALWAYS, FILE_ATTRIBUTE_NORMAL, nullptr);
+        }
+        if (handle == INVALID_HANDLE_VALUE) return; // Unwritable directory: nothing to share either
+        OVERLAPPED ov = {};
+        LockFileEx(handle, LOCKFILE_EXCLUSIVE_LOCK, 0, 1, 0, &ov);
+        #else
+        if (fd < 0) fd = open(".glupe.lock.lck", O_RDWR | O_CREAT | O_CLOEXEC, 0644);
+        if (fd < 0) return;
+        while (flock(fd, LOCK_EX) != 0 && errno == EINTR) {}
+        #endif
+    }
+
+    void unlock() {
+        #ifdef _WIN32
+        if (handle == INVALID_HANDLE_VALUE) return;
+        OVERLAPPED ov = {};
+        UnlockFileEx(handle, 0, 1, 0, &ov);
+        #else
+        if (fd >= 0) flock(fd, LOCK_UN);
+        #endif
+    }
+};
+inline LockfileMutex LOCKFILE_MUTEX; // Taken after LOCK_JOURNAL_MUTEX, never before
+
+// --- LOCK JOURNAL ---
+// Per-container updates are appended to .glupe.lock.journal (one JSON record per line) instead of
+// rewriting the whole lockfile each time. saveCache() compacts journal + memory into a fresh
+// snapshot; initCache() replays snapshot + journal, so an interrupted build keeps its progress.
+inline const string LOCK_JOURNAL_FILE = LOCK_FILE + ".journal";
+inline const int LOCK_JOURNAL_SYNC_EVERY = 32;        // fsync after this many records
+inline const int LOCK_JOURNAL_COMPACT_RECORDS = 4096; // compact early past this many records
+
+inline FILE* LOCK_JOURNAL = nullptr;
+inline int LOCK_JOURNAL_RECORDS = 0;
+inline int LOCK_JOURNAL_UNSYNCED = 0;
+inline mutex LOCK_JOURNAL_MUTEX;
+
+inline void syncLockJournal() {
+    if (!LOCK_JOURNAL || LOCK_JOURNAL_UNSYNCED == 0) return;
+    fflush(LOCK_JOURNAL);
+    #ifdef _WIN32
+    _commit(_fileno(LOCK_JOURNAL));
+    #else
+    fsync(fileno(LOCK_JOURNAL));
+    #endif
+    LOCK_JOURNAL_UNSYNCED = 0;
+}
+
+inline void flushLockJournal() {
+    lock_guard<mutex> lock(LOCK_JOURNAL_MUTEX);
+    syncLockJournal();
+}
+
+inline void closeLockJournal() {
+    if (!LOCK_JOURNAL) return;
+    syncLockJournal();
+    fclose(LOCK_JOURNAL);
+    LOCK_JOURNAL = nullptr;
+}
+
+// Applies journal records on top of the loaded snapshot. A torn last line (crash mid-write) ends the replay.
+inline int replayLockJournal(json& data) {
+    ifstream f(LOCK_JOURNAL_FILE, ios::binary);
+    if (!f.is_open()) return 0;
+    string line;
+    int applied = 0;
+    while (getline(f, line)) {
+        if (line.empty()) continue;
+        json rec = json::parse(line, nullptr, false);
+        if (rec.is_discarded() || !rec.contains("id") || !rec.contains("entry")) {
+            cout << "   [WARN] Lock journal truncated after " << applied << " record(s). Ignoring the rest." << endl;
+            break;
+        }
+        string section = rec.value("op", "") == "variable" ? "variables" : "containers";
+        data[section][rec["id"].get<string>()] = rec["entry"];
+        applied++;
+    }
+    return applied;
+}
+
+// Snapshot + journal as currently on disk (caller holds LOCKFILE_MUTEX)
+inline json readLockState(int* journalRecords = nullptr) {
+    json data = json::object();
     if (fs::exists(LOCK_FILE)) {
-        try {
-            ifstream f(LOCK_FILE);
-            LOCK_DATA = json::parse(f);
-        } catch(...) { LOCK_DATA = json::object(); }
-    } else {
-        LOCK_DATA = json::object();
-        LOCK_DATA["containers"] = json::object();
-        LOCK_DATA["variables"] = json::object();
+        ifstream f(LOCK_FILE);
+        data = json::parse(f, nullptr, false);
+        if (data.is_discarded() || !data.is_object()) data = json::object();
+    }
+    if (!data.contains("containers")) data["containers"] = json::object();
+    if (!data.contains("variables")) data["variables"] = json::object();
+    int applied = replayLockJournal(data);
+    if (journalRecords) *journalRecords = applied;
+    return data;
+}
+
+inline void saveCache();
+
+// Appends one record; caller serializes LOCK_DATA updates (the journal itself is thread-safe).
+inline void appendLockJournal(const string& op, const string& id, const json& entry) {
+    bool compact = false;
+    {
+        lock_guard<mutex> lock(LOCK_JOURNAL_MUTEX);
+        lock_guard<LockfileMutex> fileLock(LOCKFILE_MUTEX);
+        // Append mode writes at the current end, so a journal another run compacted (truncated) is fine to keep using
+        if (!LOCK_JOURNAL) LOCK_JOURNAL = fopen(LOCK_JOURNAL_FILE.c_str(), "ab");
+        if (LOCK_JOURNAL) {
+            string rec = json{{"op", op}, {"id", id}, {"entry", entry}}.dump() + "\n";
+            fwrite(rec.data(), 1, rec.size(), LOCK_JOURNAL);
+            fflush(LOCK_JOURNAL); // Survives a crash of this process; fsync below covers power loss
+            LOCK_JOURNAL_RECORDS++;
+            if (++LOCK_JOURNAL_UNSYNCED >= LOCK_JOURNAL_SYNC_EVERY) syncLockJournal();
+        }
+        // Past the threshold, or no journal at all (e.g. unwritable dir): fall back to a full write
+        compact = !LOCK_JOURNAL || LOCK_JOURNAL_RECORDS >= LOCK_JOURNAL_COMPACT_RECORDS;
+    }
+    if (compact) saveCache();
+}
+
+inline void journalContainer(const string& id) {
+    if (LOCK_DATA.contains("containers") && LOCK_DATA["containers"].contains(id)) {
+        appendLockJournal("container", id, LOCK_DATA["containers"][id]);
+    }
+}
+
+inline void journalVariable(const SemanticNode& node) {
+    appendLockJournal("variable", node.id, { {"content", node.content}, {"hash", node.hash} });
+}
+
+inline void initCache() {
+    if (!fs::exists(CACHE_DIR)) fs::create_directories(CACHE_DIR);
+    {
+        lock_guard<LockfileMutex> fileLock(LOCKFILE_MUTEX);
+        LOCK_DATA = readLockState(&LOCK_JOURNAL_RECORDS);
     }
+    LOCK_BASE = LOCK_DATA;
+    if (VERBOSE_MODE && LOCK_JOURNAL_RECORDS > 0) cout << "   [CACHE] Replayed " << LOCK_JOURNAL_RECORDS << " lock journal record(s)." << endl;
 
     // [NEW] Load persistent variables from lockfile
     if (LOCK_DATA.contains("variables")) {
@@ -57,7 +205,14 @@ inline void initCache() {
     }
 }
 
+// Compaction: writes the full snapshot, then empties the journal it supersedes. Entries this run
+// did not change are taken from disk, so concurrent runs keep each other's updates.
+// The journal is truncated in place rather than deleted: Windows refuses to delete a file another
+// run has open, and a surviving stale journal would be replayed over the newer snapshot.
 inline void saveCache() {
+    lock_guard<mutex> lock(LOCK_JOURNAL_MUTEX);
+    lock_guard<LockfileMutex> fileLock(LOCKFILE_MUTEX);
+
     // [NEW] Save persistent variables
     json vars = json::object();
     for (const auto& [key, node] : SYMBOL_TABLE) {
@@ -67,26 +222,131 @@ inline void saveCache() {
     }
     LOCK_DATA["variables"] = vars;
 
-    ofstream f(LOCK_FILE);
-    f << LOCK_DATA.dump(4);
+    json merged = readLockState();
+    for (const auto& [key, value] : LOCK_DATA.items()) {
+        bool section = (key == "containers" || key == "variables") && value.is_object();
+        if (!section) {
+            if (!LOCK_BASE.contains(key) || LOCK_BASE[key] != value) merged[key] = value;
+            continue;
+        }
+        const json base = LOCK_BASE.value(key, json::object());
+        for (const auto& [id, entry] : value.items()) {
+            if (!base.contains(id) || base[id] != entry) merged[key][id] = entry;
+        }
+        for (const auto& [id, entry] : base.items()) {
+            if (!value.contains(id) && merged[key].contains(id) && merged[key][id] == entry) merged[key].erase(id); // Removed here
+        }
+    }
+
+    // Snapshot goes to a temp file first; a crash before the rename leaves old snapshot + journal intact
+    string tmp = LOCK_FILE + ".tmp" + to_string(processId());
+    {
+        ofstream f(tmp);
+        f << merged.dump(4);
+        if (!f) return;
+    }
+    std::error_code ec;
+    fs::rename(tmp, LOCK_FILE, ec);
+    if (ec) { fs::remove(tmp, ec); return; }
+
+    closeLockJournal();
+    if (fs::exists(LOCK_JOURNAL_FILE, ec)) {
+        FILE* journal = fopen(LOCK_JOURNAL_FILE.c_str(), "wb");
+        if (journal) fclose(journal);
+        else fs::remove(LOCK_JOURNAL_FILE, ec);
+    }
+    LOCK_JOURNAL_RECORDS = 0;
+    LOCK_DATA = merged;
+    LOCK_BASE = merged;
+}
+
+// Digest of everything that decides what the model returns for a container:
+// the resolved prompt, its parents' digests, the target language, model and protocol.
+inline string getContainerHash(const string& prompt, const vector<string>& parentHashes = {}) {
+    Sha256 h;
+    h.field("glupe-container-v1").field(PROTOCOL).field(MODEL_ID).field(CURRENT_LANG.id).field(prompt);
+    for (const auto& p : parentHashes) h.field(p);
+    return h.hex();
 }
 
-inline string getContainerHash(const string& prompt) {
-    hash<string> hasher;
-    return to_string(hasher(prompt));
+// glupe_cache/<aa>/<digest>
+inline string getCachePath(const string& digest) {
+    return CACHE_DIR + "/" + digest.substr(0, 2) + "/" + digest;
 }
 
-inline string getCachedContent(const string& id) {
-    string path = CACHE_DIR + "/" + id + ".txt";
-    if (fs::exists(path)) {
-        ifstream f(path);
-        return string((istreambuf_iterator<char>(f)), istreambuf_iterator<char>());
+inline string getCachedContent(const string& digest) {
+    if (digest.size() < 2) return "";
+    ifstream f(getCachePath(digest), ios::binary);
+    if (!f.is_open()) return "";
+    return string((istreambuf_iterator<char>(f)), istreambuf_iterator<char>());
+}
+
+inline void setCachedContent(const string& digest, const string& content) {
+    if (digest.size() < 2) return;
+    string path = getCachePath(digest);
+    std::error_code ec;
+    fs::create_directories(fs::path(path).parent_path(), ec);
+
+    // Write-then-rename so concurrent builds sharing the store never see a partial entry
+    string tmp = path + ".tmp" + to_string(processId()) + "_" + to_string(hash<thread::id>{}(this_thread::get_id()));
+    {
+        ofstream f(tmp, ios::binary);
+        f << content;
     }
-    return "";
+    fs::rename(tmp, path, ec);
+    if (ec) fs::remove(tmp, ec);
+}
+
+// Digest currently recorded in the lockfile for a container id ("" if none)
+inline string getLockedHash(const string& id) {
+    if (!LOCK_DATA.contains("containers") || !LOCK_DATA["containers"].contains(id)) return "";
+    const json& entry = LOCK_DATA["containers"][id];
+    return (entry.contains("hash") && entry["hash"].is_string()) ? entry["hash"].get<string>() : "";
 }
 
-inline void setCachedContent(const string& id, const string& content) {
-    string path = CACHE_DIR + "/" + id + ".txt";
-    ofstream f(path);
-    f << content;
-}
\ No newline at end of file
+// --- CHECKPOINTS ---
+// Long refine and series runs record each finished chunk/file as one JSONL line in
+// glupe_cache/checkpoints/<kind>_<input digest>.jsonl. --resume replays it so a run that died on
+// chunk 37 of 60 starts at 37; a run that finishes removes it. Every record carries the digest of
+// what it was made from, so a changed chunk is regenerated rather than reused.
+struct Checkpoint {
+    string path;
+    map<size_t, json> done; // index -> record (from the last run, with --resume)
+    mutex m;
+
+    Checkpoint(const string& kind, const string& inputDigest, bool resume) {
+        path = CACHE_DIR + "/checkpoints/" + kind + "_" + inputDigest.substr(0, 16) + ".jsonl";
+        std::error_code ec;
+        if (!resume) { fs::remove(path, ec); return; }
+        ifstream f(path);
+        string line;
+        while (getline(f, line)) {
+            json rec = json::parse(line, nullptr, false); // A line cut short by a crash (or edited by hand) is skipped
+            if (rec.is_discarded() || !rec.is_object() || !rec.contains("index") || !rec.contains("digest")) continue;
+            if (!rec["index"].is_number_unsigned() || !rec["digest"].is_string()) continue;
+            done[rec["index"].get<size_t>()] = rec;
+        }
+    }
+
+    // The record for item `index` if it was made from `digest`
+    const json* find(size_t index, const string& digest) const {
+        auto it = done.find(index);
+        return (it != done.end() && it->second.value("digest", "") == digest) ? &it->second : nullptr;
+    }
+
+    void record(size_t index, const string& digest, json rec) {
+        rec["index"] = index;
+        rec["digest"] = digest;
+        string line = rec.dump() + "\n";
+        lock_guard<mutex> lock(m);
+        std::error_code ec;
+        fs::create_directories(fs::path(path).parent_path(), ec);
+        ofstream f(path, ios::app | ios::binary);
+        f << line;
+    }
+
+    void finish() {
+        std::error_code ec;
+        fs::remove(path, ec);
+    }
+};
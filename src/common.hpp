@@ -19,12 +19,16 @@
 #include <set>
 #include <memory>
 #include <limits>
+#include <mutex>
+#include <atomic>
 
 // Platform Specifics
 #ifdef _WIN32
     #ifndef NOMINMAX
         #define NOMINMAX
     #endif
+    #include <winsock2.h>
+    #include <ws2tcpip.h>
     #include <windows.h>
 #else
     #include <unistd.h>
@@ -9,11 +9,47 @@ inline string API_KEY = "";
 inline string MODEL_ID = ""; 
 inline string API_URL = "";
 inline int MAX_RETRIES = 15;
+inline int PARALLEL_JOBS = 1; // Concurrent LLM requests (-j N or "jobs" in config.json)
+inline int SPECULATE = 1;     // Candidates per generation pass, built in parallel (-speculate K or "speculate")
+// -fill context budget per container, in tokens ("context_tokens"); larger files are pruned to the
+// container's dependency slice. Parallel -refine caps each chunk's file outline with it too.
+// 0 always sends the whole file.
+inline int CONTEXT_TOKENS = 8000;
+// LLM response cache: off | read (read-through) | record (always call, store) | replay (cache only)
+// Set with -llm-cache <mode>, GLUPE_LLM_CACHE or "llm_cache" in config.json
+inline string LLM_CACHE_MODE = "off";
+inline bool STREAM_MODE = false; // Stream LLM responses as they are generated (-stream or "stream" in config.json)
+// Tree shaking is local for C, C++, Python and JavaScript; other languages only get the LLM pass
+// when asked for (-llm-shake or "llm_shake" in config.json)
+inline bool LLM_SHAKE = false;
+
+// One server of an endpoint pool ("endpoints" in a config.json profile). callAI spreads requests
+// over the pool (balancer.hpp); without a pool API_URL is the only endpoint.
+struct LlmEndpoint {
+    string url;
+    string model;            // Empty: the profile's model_id
+    int weight = 1;          // Relative share of the requests
+    int maxConcurrency = 0;  // Requests in flight at once (0: unlimited)
+    int rpm = 0;             // Requests per minute (0: unlimited)
+    int tpm = 0;             // Tokens per minute, prompt + answer (0: unlimited)
+};
+inline vector<LlmEndpoint> API_ENDPOINTS;
+inline int API_RPM = 0; // Profile-wide "rpm"/"tpm": the default for every endpoint
+inline int API_TPM = 0;
+// Ollama "keep_alive" (profile key): keeps the model, and the KV cache of the shared prompt prefix,
+// loaded between the requests of a build. A duration ("30m") or seconds (-1: forever); "" or null
+// leaves it to the server (5m).
+inline json OLLAMA_KEEP_ALIVE = "30m";
+
+inline bool isLlmCacheMode(const string& m) {
+    return m == "off" || m == "read" || m == "record" || m == "replay";
+}
 
 // --- CONFIG & TOOLCHAIN OVERRIDES ---
 inline bool loadConfig(string mode) {
     string configPath = "config.json";
     ifstream f(configPath);
+    if (getenv("GLUPE_LLM_CACHE") && isLlmCacheMode(getenv("GLUPE_LLM_CACHE"))) LLM_CACHE_MODE = getenv("GLUPE_LLM_CACHE");
     if (!f.is_open()) {
         if(mode == "local") {
             API_URL = "http://localhost:11434/api/generate";
@@ -29,6 +65,24 @@ inline bool loadConfig(string mode) {
         if (j.contains("max_retries")) {
             MAX_RETRIES = j["max_retries"];
         }
+        if (j.contains("jobs")) {
+            PARALLEL_JOBS = max(1, j["jobs"].get<int>());
+        }
+        if (j.contains("speculate")) {
+            SPECULATE = max(1, j["speculate"].get<int>());
+        }
+        if (j.contains("stream")) {
+            STREAM_MODE = j["stream"].get<bool>();
+        }
+        if (j.contains("llm_shake")) {
+            LLM_SHAKE = j["llm_shake"].get<bool>();
+        }
+        if (j.contains("context_tokens")) {
+            CONTEXT_TOKENS = max(0, j["context_tokens"].get<int>());
+        }
+        if (j.contains("llm_cache") && !getenv("GLUPE_LLM_CACHE") && isLlmCacheMode(j["llm_cache"].get<string>())) {
+            LLM_CACHE_MODE = j["llm_cache"];
+        }
         if (j.contains(mode)) {
             json profile = j[mode];
             PROVIDER = mode;
@@ -47,6 +101,35 @@ inline bool loadConfig(string mode) {
             }
 
             if (mode == "cloud") API_KEY = profile.value("api_key", "");
+
+            if (profile.contains("keep_alive")) OLLAMA_KEEP_ALIVE = profile["keep_alive"];
+            API_RPM = max(0, profile.value("rpm", 0));
+            API_TPM = max(0, profile.value("tpm", 0));
+
+            // "endpoints": ["http://a:11434/api/generate", {"api_url": ..., "weight": 2, "max_concurrency": 4, "rpm": 60, "tpm": 100000, "model_id": ...}]
+            API_ENDPOINTS.clear();
+            if (profile.contains("endpoints") && profile["endpoints"].is_array()) {
+                for (auto& e : profile["endpoints"]) {
+                    LlmEndpoint ep;
+                    ep.rpm = API_RPM;
+                    ep.tpm = API_TPM;
+                    if (e.is_string()) {
+                        ep.url = e;
+                    } else if (e.is_object() && e.contains("api_url")) {
+                        ep.url = e["api_url"];
+                        ep.model = e.value("model_id", "");
+                        ep.weight = max(1, e.value("weight", 1));
+                        ep.maxConcurrency = max(0, e.value("max_concurrency", 0));
+                        ep.rpm = max(0, e.value("rpm", API_RPM));
+                        ep.tpm = max(0, e.value("tpm", API_TPM));
+                    } else {
+                        continue;
+                    }
+                    API_ENDPOINTS.push_back(ep);
+                }
+                // The first endpoint stands for the pool in cache keys and messages
+                if (!API_ENDPOINTS.empty()) API_URL = API_ENDPOINTS[0].url;
+            }
         }
         if (j.contains("toolchains")) {
             for (auto& [key, val] : j["toolchains"].items()) {
@@ -103,6 +186,54 @@ inline void updateConfigFile(string key, string value) {
                  cout << "[ERROR] max-retries must be > 0." << endl; return;
              }
          } catch (...) { cout << "[ERROR] Invalid number." << endl; return; }
+    } else if (key == "jobs") {
+         try {
+             int v = stoi(value);
+             if (v > 0) {
+                 j["jobs"] = v;
+                 cout << "[CONFIG] Updated jobs to " << v << endl;
+             } else {
+                 cout << "[ERROR] jobs must be > 0." << endl; return;
+             }
+         } catch (...) { cout << "[ERROR] Invalid number." << endl; return; }
+    } else if (key == "speculate") {
+         try {
+             int v = stoi(value);
+             if (v > 0) {
+                 j["speculate"] = v;
+                 cout << "[CONFIG] Updated speculate to " << v << endl;
+             } else {
+                 cout << "[ERROR] speculate must be > 0." << endl; return;
+             }
+         } catch (...) { cout << "[ERROR] Invalid number." << endl; return; }
+    } else if (key == "context-tokens") {
+         try {
+             int v = stoi(value);
+             if (v >= 0) {
+                 j["context_tokens"] = v;
+                 cout << "[CONFIG] Updated context_tokens to " << v << endl;
+             } else {
+                 cout << "[ERROR] context-tokens must be >= 0." << endl; return;
+             }
+         } catch (...) { cout << "[ERROR] Invalid number." << endl; return; }
+    } else if (key == "stream") {
+         if (value != "on" && value != "off") {
+             cout << "[ERROR] stream must be 'on' or 'off'." << endl; return;
+         }
+         j["stream"] = (value == "on");
+         cout << "[CONFIG] Updated stream to " << value << endl;
+    } else if (key == "llm-shake") {
+         if (value != "on" && value != "off") {
+             cout << "[ERROR] llm-shake must be 'on' or 'off'." << endl; return;
+         }
+         j["llm_shake"] = (value == "on");
+         cout << "[CONFIG] Updated llm_shake to " << value << endl;
+    } else if (key == "llm-cache") {
+         if (!isLlmCacheMode(value)) {
+             cout << "[ERROR] llm-cache must be off, read, record or replay." << endl; return;
+         }
+         j["llm_cache"] = value;
+         cout << "[CONFIG] Updated llm_cache to " << value << endl;
     } else {
         cout << "[ERROR] Unknown config key." << endl;
         return;
@@ -126,12 +257,32 @@ inline void showConfig() {
         if (j.contains("max_retries")) cout << "  Max Retries: " << j["max_retries"] << endl;
         else cout << "  Max Retries: 15 (Default)" << endl;
         
+        if (j.contains("jobs")) cout << "  Jobs: " << j["jobs"] << endl;
+        else cout << "  Jobs: 1 (Default)" << endl;
+        
+        if (j.contains("speculate")) cout << "  Speculate: " << j["speculate"] << endl;
+        else cout << "  Speculate: 1 (Default)" << endl;
+        
+        if (j.contains("context_tokens")) cout << "  Context Tokens: " << j["context_tokens"] << endl;
+        else cout << "  Context Tokens: 8000 (Default)" << endl;
+        
+        if (j.contains("stream")) cout << "  Stream: " << (j["stream"].get<bool>() ? "on" : "off") << endl;
+        else cout << "  Stream: off (Default)" << endl;
+        
+        if (j.contains("llm_shake")) cout << "  LLM Tree Shaking: " << (j["llm_shake"].get<bool>() ? "on" : "off") << endl;
+        else cout << "  LLM Tree Shaking: off (Default)" << endl;
+        
+        if (j.contains("llm_cache")) cout << "  LLM Cache: " << j["llm_cache"].get<string>() << endl;
+        else cout << "  LLM Cache: off (Default)" << endl;
+        
         if (j.contains("cloud")) {
             cout << "[CLOUD]\n";
             auto& c = j["cloud"];
             if (c.contains("protocol")) cout << "  Protocol : " << c["protocol"].get<string>() << endl;
             if (c.contains("model_id")) cout << "  Model    : " << c["model_id"].get<string>() << endl;
             if (c.contains("api_url"))  cout << "  URL      : " << c["api_url"].get<string>() << endl;
+            if (c.contains("endpoints")) cout << "  Endpoints: " << c["endpoints"].dump() << endl;
+            if (c.contains("rpm") || c.contains("tpm")) cout << "  Limits   : " << c.value("rpm", 0) << " rpm, " << c.value("tpm", 0) << " tpm" << endl;
             if (c.contains("api_key")) {
                 string k = c["api_key"].get<string>();
                 if (k.length() > 6) k = k.substr(0, 3) + "..." + k.substr(k.length()-3);
@@ -145,6 +296,8 @@ inline void showConfig() {
             auto& l = j["local"];
             if (l.contains("model_id")) cout << "  Model    : " << l["model_id"].get<string>() << endl;
             if (l.contains("api_url"))  cout << "  URL      : " << l["api_url"].get<string>() << endl;
+            if (l.contains("endpoints")) cout << "  Endpoints: " << l["endpoints"].dump() << endl;
+            if (l.contains("rpm") || l.contains("tpm")) cout << "  Limits   : " << l.value("rpm", 0) << " rpm, " << l.value("tpm", 0) << " tpm" << endl;
         }
         cout << "--------------------------\n";
     } catch (...) { cout << "[ERROR] Corrupt or invalid config file." << endl; }
@@ -14,6 +14,7 @@
 #include "cache.hpp"
 #include "parser.hpp"
 #include "processor.hpp"
+#include "verify.hpp"
 #include "hub.hpp"
 
 void showHelp() {
@@ -30,8 +31,14 @@ void showHelp() {
     cout << "  -refine          : Refine mode (reverse engineer code to .glp blueprint).\n";
     cout << "  -t, --transpile  : Transpile only (do not compile binary).\n";
     cout << "  -run             : Run the output binary after compilation.\n";
-    cout << "  -crono           : Measure execution time.\n";
+    cout << "  -crono           : Report total and per-phase time plus LLM requests and bytes.\n";
     cout << "  -fill            : Fill containers in-place (preserves manual code).\n";
+    cout << "  -j <N>           : Generate up to N containers (or -refine chunks) concurrently (default: 1).\n";
+    cout << "  -speculate <K>   : Request K candidates per pass at once; the first one that builds wins.\n";
+    cout << "  -stream          : Stream LLM responses as they are generated (progress, partial output).\n";
+    cout << "  -llm-shake       : Ask the LLM to tree-shake languages without a local tree shaker.\n";
+    cout << "  --resume         : Continue an interrupted -refine or -series run from its checkpoint.\n";
+    cout << "  -llm-cache <m>   : LLM response cache: off, read, record, replay (or GLUPE_LLM_CACHE).\n";
     cout << "  -dry-run         : Show prompt/context without calling AI.\n";
     cout << "  -verbose         : Enable verbose logging.\n";
     cout << "  -3d              : 3D model generation mode.\n";
@@ -103,6 +110,12 @@ int main(int argc, char* argv[]) {
             cout << "Keys:\n";
             cout << "  api-key         : Set Cloud API Key\n";
             cout << "  max-retries     : Set Max Retries (Default: 15)\n";
+            cout << "  jobs            : Set concurrent LLM requests (Default: 1)\n";
+            cout << "  speculate       : Candidates built in parallel per generation pass (Default: 1)\n";
+            cout << "  stream          : on | off, stream LLM responses (Default: off)\n";
+            cout << "  llm-shake       : on | off, LLM tree shaking where no local one exists (Default: off)\n";
+            cout << "  context-tokens  : -fill context budget per container, 0 = whole file (Default: 8000)\n";
+            cout << "  llm-cache       : off | read | record | replay (Default: off)\n";
             cout << "  cloud-protocol  : Set protocol ('openai', 'google', 'ollama')\n";
             cout << "  model-cloud     : Set Cloud Model ID\n";
             cout << "  url-cloud       : Set Cloud API URL\n";
@@ -747,57 +760,19 @@ int main(int argc, char* argv[]) {
         f.close();
 
         string newContent;
-        size_t pos = 0;
         bool found = false;
-        while ((pos = content.find("$$", pos)) != string::npos) {
-            size_t scan = pos + 2;
-            while (scan < content.length() && isspace(content[scan])) scan++;
+        for (const GlupeToken& tok : lexGlupe(content)) {
+            if (tok.kind != GlupeTokenKind::CONTAINER || !tok.isBlock || !tok.closed) continue;
+            if (tok.id != containerName && tok.id != "\"" + containerName + "\"") continue;
 
-            if (content.substr(scan, 8) == "ABSTRACT") {
-                scan += 8;
-                while (scan < content.length() && isspace(content[scan])) scan++;
-            }
-
-            string currentId;
-            if (content[scan] == '"') {
-                size_t idStart = scan + 1;
-                size_t idEnd = content.find('"', idStart);
-                if (idEnd != string::npos) {
-                    currentId = content.substr(idStart, idEnd - idStart);
-                    scan = idEnd + 1;
-                }
-            } else {
-                size_t idStart = scan;
-                while (scan < content.length() && !isspace(content[scan]) && content[scan] != '{' && content.substr(scan, 2) != "->") {
-                    scan++;
-                }
-                currentId = content.substr(idStart, scan - idStart);
-            }
-
-            if (currentId == containerName) {
-                while (scan < content.length() && isspace(content[scan])) scan++;
-                if (content.substr(scan, 2) == "->") {
-                    scan += 2;
-                    while (scan < content.length() && content[scan] != '{') scan++;
-                }
-                while (scan < content.length() && isspace(content[scan])) scan++;
-
-                if (content[scan] == '{') {
-                    size_t contentStart = scan + 1;
-                    size_t contentEnd = content.find("}$$", contentStart);
-                    if (contentEnd != string::npos) {
-                        string before = content.substr(0, contentStart);
-                        string after = content.substr(contentEnd);
-                        string originalPrompt = content.substr(contentStart, contentEnd - contentStart);
-                        size_t firstChar = originalPrompt.find_first_not_of(" \t\r\n");
-                        string padding = (firstChar != string::npos) ? originalPrompt.substr(0, firstChar) : "\n    ";
-                        newContent = before + padding + newPrompt + padding + after;
-                        found = true;
-                        break;
-                    }
-                }
-            }
-            pos++;
+            string before = content.substr(0, tok.contentStart);
+            string after = content.substr(tok.contentEnd);
+            string originalPrompt = content.substr(tok.contentStart, tok.contentEnd - tok.contentStart);
+            size_t firstChar = originalPrompt.find_first_not_of(" \t\r\n");
+            string padding = (firstChar != string::npos) ? originalPrompt.substr(0, firstChar) : "\n    ";
+            newContent = before + padding + newPrompt + padding + after;
+            found = true;
+            break;
         }
 
         if (!found) {
@@ -832,6 +807,12 @@ int main(int argc, char* argv[]) {
     bool refineMode = false;
     bool blindMode = false;
     bool fillMode = false;
+    int jobsOverride = 0;
+    int speculateOverride = 0;
+    string llmCacheOverride = "";
+    bool streamFlag = false;
+    bool llmShakeFlag = false;
+    bool resumeMode = false;
 
     for(int i=1; i<argc; i++) {
         string arg = argv[i];
@@ -849,6 +830,16 @@ int main(int argc, char* argv[]) {
         else if (arg == "-series") seriesMode = true;
         else if (arg == "-refine") refineMode = true;
         else if (arg == "-fill") fillMode = true;
+        else if (arg == "-j" && i+1 < argc) { jobsOverride = max(1, atoi(argv[i+1])); i++; }
+        else if (arg.size() > 2 && arg.rfind("-j", 0) == 0 && all_of(arg.begin() + 2, arg.end(), ::isdigit)) jobsOverride = max(1, atoi(arg.c_str() + 2));
+        else if (arg == "-speculate" && i+1 < argc) { speculateOverride = max(1, atoi(argv[i+1])); i++; }
+        else if (arg == "-stream") streamFlag = true;
+        else if (arg == "-llm-shake") llmShakeFlag = true;
+        else if (arg == "--resume" || arg == "-resume") resumeMode = true;
+        else if (arg == "-llm-cache" && i+1 < argc) {
+            llmCacheOverride = argv[++i];
+            if (!isLlmCacheMode(llmCacheOverride)) { cerr << "[ERROR] -llm-cache must be off, read, record or replay." << endl; return 1; }
+        }
         else if (arg == "-crono") cronoTimer.enabled = true;
         else if (arg == "-3d") CURRENT_MODE = GenMode::MODEL_3D;
         else if (arg == "-img") CURRENT_MODE = GenMode::IMAGE;
@@ -858,10 +849,12 @@ int main(int argc, char* argv[]) {
             cout << "[CLEAN] Removing temporary build files..." << endl;
             try {
                 if (fs::exists(".glupe_build.cache")) fs::remove(".glupe_build.cache");
+                if (fs::exists(SCRATCH_ROOT)) fs::remove_all(SCRATCH_ROOT);
                 for (const auto& entry : fs::directory_iterator(fs::current_path())) {
                     if (entry.is_regular_file()) {
                         string fname = entry.path().filename().string();
                         if (fname.find("temp_build") == 0) fs::remove(entry.path());
+                        else if (fname.rfind(".glupe_build.", 0) == 0 && getExt(fname) == ".cache") fs::remove(entry.path());
                     }
                 }
             } catch (...) {}
@@ -915,9 +908,17 @@ int main(int argc, char* argv[]) {
 
     if (inputFiles.empty()) { cerr << "No input files." << endl; return 1; }
     if (!loadConfig(mode)) return 1;
+    if (jobsOverride > 0) PARALLEL_JOBS = jobsOverride;
+    if (speculateOverride > 0) SPECULATE = speculateOverride;
+    if (!llmCacheOverride.empty()) LLM_CACHE_MODE = llmCacheOverride;
+    if (streamFlag) STREAM_MODE = true;
+    if (llmShakeFlag) LLM_SHAKE = true;
+    if (LLM_CACHE_MODE != "off") cout << "[LLM-CACHE] Mode: " << LLM_CACHE_MODE << endl;
+    cronoTimer.summary = llmTrafficSummary;
 
     // [NEW] Refine Mode: Semantic Compression
     if (refineMode) {
+        cronoTimer.phase("refine");
         for (const auto& file : inputFiles) {
             cout << "[REFINE] Processing " << file << "..." << endl;
             if (!fs::exists(file)) {
@@ -931,14 +932,42 @@ int main(int argc, char* argv[]) {
 
             // [UPDATED] Sliding Window Logic
             vector<string> chunks = splitSourceCode(content);
-            
-            string fullRefinedCode = "";
-            string previousContext = "";
-
-            cout << "[AI] Semantic compression (" << mode << ") - " << chunks.size() << " chunks..." << endl;
-
-            for (size_t i = 0; i < chunks.size(); ++i) {
-                cout << "   -> Processing chunk " << (i + 1) << "/" << chunks.size() << "..." << endl;
+            vector<string> refined(chunks.size());
+
+            // [NEW] With -j N chunks are refined concurrently; each gets its context from the source
+            // (file outline + neighbouring lines) instead of the previous chunk's answer
+            bool parallelRefine = PARALLEL_JOBS > 1 && chunks.size() > 1;
+            const int REFINE_OVERLAP_LINES = 20;
+
+            // [NEW] Finished chunks are checkpointed; --resume picks up after the last one. The run is
+            // keyed by file, model and mode (sequential and -j prompts differ); each chunk's own digest
+            // decides whether it is reused, so an edit only costs the chunks it touched.
+            Sha256 runKey;
+            runKey.field("glupe-refine-v2").field(fs::absolute(file).string()).field(mode).field(MODEL_ID).field(parallelRefine ? "parallel" : "sequential");
+            Checkpoint checkpoint("refine", runKey.hex(), resumeMode);
+            size_t restored = 0;
+            atomic<size_t> finished{0};
+            auto restoreChunk = [&](size_t i) {
+                const json* rec = checkpoint.find(i, sha256Hex(chunks[i]));
+                if (!rec || !rec->contains("output") || !(*rec)["output"].is_string()) return false;
+                refined[i] = (*rec)["output"].get<string>();
+                restored++;
+                finished++;
+                return true;
+            };
+
+            cout << "[AI] Semantic compression (" << mode << ") - " << chunks.size() << " chunks";
+            if (parallelRefine) cout << ", up to " << min((size_t)PARALLEL_JOBS, chunks.size()) << " at a time";
+            cout << "..." << endl;
+
+            auto say = [](const string& line) {
+                lock_guard<mutex> lock(LOG_MUTEX);
+                cout << line << endl;
+            };
+
+            // Refines chunks[i] into refined[i]; `context` is what the chunk may rely on from the rest of the file
+            auto refineChunk = [&](size_t i, const string& context) {
+                say("   -> Processing chunk " + to_string(i + 1) + "/" + to_string(chunks.size()) + "...");
                 
                 bool isSpaghetti = detectIfCodeIsSpaghetti(chunks[i]);
                 stringstream prompt;
@@ -955,7 +984,7 @@ int main(int argc, char* argv[]) {
                     : "- 1:1 Functional mapping. DO NOT omit any logic.";
 
                 if (isSpaghetti) {
-                    cout << "      [!] Spaghetti Code Detected. Enabling Refactoring Mode." << endl;
+                    say("      [!] Spaghetti Code Detected in chunk " + to_string(i + 1) + ". Enabling Refactoring Mode.");
                     prompt << "ROLE: Expert Legacy Code Refactorer & Systems Architect.\n";
                     prompt << "TASK: Refactor the following MESSY/LEGACY code into a clean, modern semantic blueprint (.glp).\n";
                     prompt << "GOAL: Untangle logic, remove redundancy, and produce a professional structure while PRESERVING FUNCTIONALITY.\n";
@@ -984,18 +1013,6 @@ int main(int argc, char* argv[]) {
                 prompt << "- Intent Focus: Name blocks by Goal (e.g., 'FilterData') rather than syntax (e.g., 'Loop1').\n";
                 prompt << "- Detail: Rewrite logic inside blocks using technical steps. Do not over-summarize.\n";
                 prompt << "- Includes/Globals: Must have their own independent semantic blocks.\n";
-                    if (i > 0) {
-                        prompt << "\n[EXTERNAL_CONTEXT_FROM_PREVIOUS_PARTS]\n";
-                        // Extraemos solo firmas y globales del contexto previo para no saturar la memoria
-                        prompt << "Existing Signatures/Globals: " << extractSignatures(previousContext) << "\n";
-                        prompt << "Maintain strict compatibility with these definitions.\n";
-                    }
-
-                if (i > 0) {
-                    prompt << "\n[CONTEXT_SYNC]\n";
-                    prompt << "Existing Signatures/Globals: " << extractSignatures(previousContext) << "\n";
-                    prompt << "Maintain STRICT compatibility with these definitions.\n";
-                }
                     prompt << "\n[STRICT_RULES]\n";
                     if (isSpaghetti) {
                         prompt << "0. REFACTOR BAD PATTERNS. Replace 'goto' with loops/control structures. Flatten deep nesting. Use meaningful names.\n";
@@ -1003,7 +1020,6 @@ int main(int argc, char* argv[]) {
 
                 prompt << "\n[OUTPUT_FORMAT]\n";
                     prompt << "RETURN ONLY the .glp fragment. NO conversation. NO markdown code blocks.\n\n";
-                    prompt << "[SOURCE_CODE_PART_" << (i + 1) << "]\n";
                     prompt << "When refining code into intent, use a numbered algorithmic format. Use standard indentation for nested logic (1, 1.1, 1.2). Do not use prose. Use imperative verbs (Get, Set, Check, Return).";
                     prompt << "Semantic blocks should represent functions, classes, and logical groupings of code. They should not be arbitrary line groupings.\n";
                     prompt << "Do not nest semantic blocks: BAD: $$ block1 { logic $$ block2 { logic } $$ }$$. GOOD: $$ block1 { logic }$$ $$ block2 { logic }$$\n";
@@ -1023,49 +1039,76 @@ int main(int argc, char* argv[]) {
                     prompt << "5. PRESERVE all #include, constants, and global variable declarations in their own semantic blocks\n";
                     prompt << "6. Return ONLY the .glp fragment for this part. No conversation. No markdown code blocks.\n";
 
+                // Everything above is the same for every chunk (a prefix the server can cache); the parts differ below
+                prompt << context;
+
                     prompt << "\n[SOURCE_CODE_PART_" << (i+1) << "]\n";
                     prompt << chunks[i] << "\n";
 
-                string refinedChunk;
-                bool success = false;
                 int retries = 0;
-
                 while (retries < MAX_RETRIES) {
-                    string response = callAI(prompt.str());
-                    refinedChunk = extractCode(response);
+                    string response = callAI(prompt.str(), streamProgress());
+                    refined[i] = extractCode(response);
 
-                    if (refinedChunk.find("ERROR:") == 0) {
-                        cout << "   [!] API Error on chunk " << (i+1) << " (Attempt " << (retries + 1) << "/" << MAX_RETRIES << "): " << refinedChunk.substr(6) << endl;
-                        string errorMsg = refinedChunk.substr(6);
-                        cout << "   [!] API Error on chunk " << (i+1) << " (Attempt " << (retries + 1) << "/" << MAX_RETRIES << "): " << errorMsg << endl;
-                        
-                        int waitTime = (1 << retries) * 2; // Exponential backoff
-
-                        // [FIX] Smart wait: Parse "wait X seconds" from error message
-                        size_t waitPos = errorMsg.find("wait ");
-                        if (waitPos != string::npos) {
-                            try {
-                                int parsedWait = stoi(errorMsg.substr(waitPos + 5));
-                                if (parsedWait > 0) waitTime = parsedWait + 2; // +2s buffer
-                            } catch(...) {}
-                        }
-
-                        cout << "       -> Retrying in " << waitTime << "s..." << endl;
-                        std::this_thread::sleep_for(std::chrono::seconds(waitTime));
+                    if (refined[i].find("ERROR:") == 0) {
+                        say("   [!] API Error on chunk " + to_string(i + 1) + " (Attempt " + to_string(retries + 1) + "/" + to_string(MAX_RETRIES) + "): " + refined[i].substr(6));
+                        if (isPermanentAIError(refined[i])) break;
+                        backoffBeforeRetry(retries, refined[i]); // Honors "wait X seconds" hints
                         retries++;
                     } else {
-                        success = true;
-                        break;
+                        checkpoint.record(i, sha256Hex(chunks[i]), {{"output", refined[i]}});
+                        finished++;
+                        return true;
                     }
                 }
+                say("   [FATAL] Failed to refine chunk " + to_string(i + 1) + " after " + to_string(MAX_RETRIES) + " attempts. Aborting operation.");
+                return false;
+            };
+            auto reportCheckpoint = [&]() {
+                cout << "[CHECKPOINT] " << finished.load() << "/" << chunks.size() << " chunks saved. Rerun with --resume to continue." << endl;
+            };
 
-                if (!success) {
-                    cout << "   [FATAL] Failed to refine chunk " << (i+1) << " after " << MAX_RETRIES << " attempts. Aborting operation." << endl;
-                    return 1;
+            string fullRefinedCode = "";
+            if (parallelRefine) {
+                vector<string> sigs;
+                for (const auto& c : chunks) sigs.push_back(extractSignatures(c));
+                atomic<bool> failed{false};
+                vector<bool> done(chunks.size());
+                for (size_t i = 0; i < chunks.size(); i++) done[i] = restoreChunk(i); // Contexts come from the source, so any chunk can be reused
+                if (restored > 0) cout << "   [CHECKPOINT] Resuming: " << restored << "/" << chunks.size() << " chunks already refined." << endl;
+                parallelFor(chunks.size(), PARALLEL_JOBS, [&](size_t i) {
+                    if (failed || done[i]) return;
+                    string context = "\n[FILE_OUTLINE]\n";
+                    context += "Signatures/Globals of the whole file: " + refineOutline(sigs, i, (size_t)CONTEXT_TOKENS * 4) + "\n";
+                    context += "Maintain STRICT compatibility with these definitions.\n";
+                    context += "\n[NEIGHBOR_CONTEXT]\n";
+                    context += "Surroundings of this part, for continuity only. Do not emit blocks for them.\n";
+                    context += refineOverlap(chunks, i, REFINE_OVERLAP_LINES);
+                    if (!refineChunk(i, context)) failed = true;
+                });
+                if (failed) { reportCheckpoint(); return 1; }
+                fullRefinedCode = stitchRefinedChunks(refined);
+            } else {
+                string previousContext = "";
+                bool reuse = true; // Each chunk's prompt depends on the previous answer: reuse only the unbroken head
+                for (size_t i = 0; i < chunks.size(); ++i) {
+                    if (reuse && (reuse = restoreChunk(i))) {
+                        fullRefinedCode += refined[i] + "\n";
+                        previousContext = refined[i];
+                        continue;
+                    }
+                    if (restored > 0 && i == restored) cout << "   [CHECKPOINT] Resuming at chunk " << (i + 1) << "/" << chunks.size() << "." << endl;
+                    string context;
+                    if (i > 0) {
+                        context += "\n[CONTEXT_SYNC]\n";
+                        // Extraemos solo firmas y globales del contexto previo para no saturar la memoria
+                        context += "Existing Signatures/Globals: " + extractSignatures(previousContext) + "\n";
+                        context += "Maintain STRICT compatibility with these definitions.\n";
+                    }
+                    if (!refineChunk(i, context)) { reportCheckpoint(); return 1; }
+                    fullRefinedCode += refined[i] + "\n";
+                    previousContext = refined[i]; // Update context for next iteration
                 }
-
-                fullRefinedCode += refinedChunk + "\n";
-                previousContext = refinedChunk; // Update context for next iteration
             }
 
             // [NEW] Sanitize syntax before saving
@@ -1075,6 +1118,7 @@ int main(int argc, char* argv[]) {
             ofstream out(outputFile);
             out << fullRefinedCode;
             out.close();
+            checkpoint.finish();
 
             cout << "[SUCCESS] Semantic file generated: " << outputFile << endl;
         }
@@ -1120,12 +1164,13 @@ int main(int argc, char* argv[]) {
         }
     }
     
+    cronoTimer.phase("toolchain");
     if (CURRENT_MODE == GenMode::CODE) {
         if (!makeMode || explicitLang) {
             cout << "[CHECK] Toolchain for " << CURRENT_LANG.name << "..." << endl;
             if (CURRENT_LANG.versionCmd.empty()) {
                 cout << "   [INFO] No toolchain required." << endl;
-            } else if (execCmd(CURRENT_LANG.versionCmd).exitCode != 0) {
+            } else if (toolchainVersion().exitCode != 0) {
                 cout << "   [!] Toolchain not found (" << CURRENT_LANG.versionCmd << "). Blind Mode." << endl;
                 blindMode = true;
             } else cout << "   [OK] Ready." << endl;
@@ -1136,6 +1181,7 @@ int main(int argc, char* argv[]) {
         cout << "[MODE] Image Generation (" << CURRENT_LANG.name << ")" << endl;
     }
 
+    cronoTimer.phase("parse");
     string aggregatedContext = "";
     vector<string> stack;
     
@@ -1178,9 +1224,12 @@ int main(int argc, char* argv[]) {
     }
 
     // [NEW] Validate containers globally before processing
+    // Lexed once; the same token stream feeds validation and container processing
+    vector<GlupeToken> glupeTokens = lexGlupe(aggregatedContext);
     bool hasActiveContainers = false;
-    if (!validateContainers(aggregatedContext, &hasActiveContainers)) return 1;
+    if (!validateContainers(aggregatedContext, &hasActiveContainers, &glupeTokens)) return 1;
 
+    cronoTimer.phase("preflight");
     // [FIX] Now it is safe to write initial exports (if any)
     for (const auto& data : loadedInputs) {
         processExports(data.content, data.path);
@@ -1189,12 +1238,12 @@ int main(int argc, char* argv[]) {
     // [NEW] Initialize Cache
     initCache();
 
-    size_t currentHash = hash<string>{}(aggregatedContext + CURRENT_LANG.id + MODEL_ID + (updateMode ? "u" : "n") + customInstructions);
-    string cacheFile = ".glupe_build.cache"; 
+    string currentHash = sha256Hex(aggregatedContext + CURRENT_LANG.id + MODEL_ID + (updateMode ? "u" : "n") + customInstructions);
+    string cacheFile = buildCachePath(outputName); // Per target, so parallel builds don't overwrite each other's
 
     if (!updateMode && !dryRun && fs::exists(cacheFile) && fs::exists(outputName)) {
         ifstream cFile(cacheFile);
-        size_t storedHash;
+        string storedHash;
         if (cFile >> storedHash && storedHash == currentHash) {
             cout << "[CACHE] No changes detected. Using existing build." << endl;
             if (runOutput) {
@@ -1213,10 +1262,12 @@ int main(int argc, char* argv[]) {
 
     // [NEW] Process Containers (Cache Check & Injection)
     // If updateMode is true, we try to use cache.
-    aggregatedContext = processInputWithCache(aggregatedContext, updateMode, updateTargets, fillMode);
+    cronoTimer.phase("containers");
+    aggregatedContext = processInputWithCache(aggregatedContext, updateMode, updateTargets, fillMode, &glupeTokens);
 
     // [SERIES MODE] Sequential Generation
     if (seriesMode) {
+        cronoTimer.phase("series");
         cout << "[SERIES] Parsing blueprint for sequential generation..." << endl;
         auto blueprint = parseBlueprint(aggregatedContext);
         
@@ -1228,38 +1279,65 @@ int main(int argc, char* argv[]) {
             int totalItems = blueprint.size();
             auto seriesStart = std::chrono::high_resolution_clock::now();
 
+            // [NEW] Each generated file is checkpointed; --resume restores the finished head of the
+            // series (every prompt includes the files before it, so reuse stops at the first change)
+            Sha256 runKey;
+            runKey.field("glupe-series-v1").field(MODEL_ID).field(CURRENT_LANG.id).field(aggregatedContext);
+            Checkpoint checkpoint("series", runKey.hex(), resumeMode);
+            bool reuse = true;
+
             for (const auto& item : blueprint) {
                 currentItem++;
+                string itemDigest = sha256Hex(item.filename + "\n" + item.content);
+                const json* rec = reuse ? checkpoint.find(currentItem - 1, itemDigest) : nullptr;
+                if (rec && rec->contains("output") && (*rec)["output"].is_string()) {
+                    string code = (*rec)["output"].get<string>();
+                    ofstream out(item.filename); out << code; out.close();
+                    cout << "   [" << currentItem << "/" << totalItems << "] " << item.filename << " restored from checkpoint." << endl;
+                    projectContext += "\n// --- FILE: " + item.filename + " ---\n" + code + "\n";
+                    continue;
+                }
+                reuse = false;
                 cout << "   [" << currentItem << "/" << totalItems << "] Generating " << item.filename << "..." << endl;
                 
+                // Rules, then the files generated so far (it only grows, so each prompt extends the
+                // previous one's prefix), then this file
                 stringstream prompt;
                 prompt << "ROLE: " << (CURRENT_MODE == GenMode::CODE ? "Software Architect" : "Asset Generator") << ".\n";
-                prompt << "TASK: Implement the file '" << item.filename << "'.\n";
-                prompt << "CONTEXT:\n" << projectContext << "\n";
-                prompt << "FILE INSTRUCTIONS:\n" << item.content << "\n";
                 prompt << "RULES:\n";
                 prompt << "1. Implement the full logic. No placeholders.\n";
                 prompt << "2. IMPORTANT: If you see '// GLUPE_BLOCK_START: id', IMPLEMENT the logic between it and '// GLUPE_BLOCK_END: id'. PRESERVE these markers exactly in the output so they can be cached.\n";
+                prompt << "CONTEXT:\n" << projectContext << "\n";
+                prompt << "TASK: Implement the file '" << item.filename << "'.\n";
+                prompt << "FILE INSTRUCTIONS:\n" << item.content << "\n";
                 prompt << "OUTPUT: Return ONLY the valid code/content for " << item.filename << ". No markdown blocks if possible.";
                 
                 string code;
                 bool success = false;
                 int retries = 0;
 
+                // Cancel answers that break container markers or are Python for a C/C++ file
+                OutputInvariants rules;
+                rules.checkBlocks = true;
+                rules.blockIds = OutputInvariants::blockIdsIn(prompt.str());
+                string itemExt = getExt(item.filename);
+                rules.rejectPython = itemExt == ".cpp" || itemExt == ".cc" || itemExt == ".c" || itemExt == ".h" || itemExt == ".hpp";
+                StreamCheck check = makeStreamCheck(rules);
+
                 while (retries < MAX_RETRIES) {
-                    string response = callAI(prompt.str());
+                    string response = callAI(prompt.str(), streamProgress(), check);
                     code = extractCode(response);
                     
-                    if (code.find("ERROR:") == 0) {
+                    if (isStreamAbort(code)) {
+                        string reason = code.substr(STREAM_ABORTED.size() + 2);
+                        cout << "   [!] Generation aborted (Attempt " << (retries + 1) << "/" << MAX_RETRIES << "): " << reason << endl;
+                        cout << "       -> Retrying now..." << endl;
+                        prompt << "\n[!] YOUR PREVIOUS ANSWER WAS CANCELLED: " << reason << ". Do not repeat this.\n";
+                        retries++;
+                    } else if (code.find("ERROR:") == 0) {
                         cout << "   [!] API Error (Attempt " << (retries + 1) << "/" << MAX_RETRIES << "): " << code.substr(6) << endl;
-                        
-                        int waitTime = 5 * (retries + 1);
-                        if (code.find("Rate limit") != string::npos || code.find("429") != string::npos) {
-                            cout << "       -> Rate limit detected. Waiting " << waitTime << "s..." << endl;
-                        } else {
-                            cout << "       -> Retrying in " << waitTime << "s..." << endl;
-                        }
-                        std::this_thread::sleep_for(std::chrono::seconds(waitTime));
+                        if (isPermanentAIError(code)) break;
+                        backoffBeforeRetry(retries, code);
                         retries++;
                     } else {
                         success = true;
@@ -1269,13 +1347,16 @@ int main(int argc, char* argv[]) {
 
                 if (!success) {
                     cout << "[FATAL] Failed to generate " << item.filename << " after " << MAX_RETRIES << " attempts. Aborting series." << endl;
+                    if (currentItem > 1) cout << "[CHECKPOINT] " << (currentItem - 1) << "/" << totalItems << " files saved. Rerun with --resume to continue." << endl;
+                    saveCache();
                     return 1;
                 }
 
                 // [NEW] Update Cache from AI Output (Series Mode)
-                code = updateCacheFromOutput(code);
+                code = updateCacheFromOutput(code, false);
 
                 ofstream out(item.filename); out << code; out.close();
+                checkpoint.record(currentItem - 1, itemDigest, {{"output", code}, {"file", item.filename}});
                 
                 // [NEW] Calculate and display ETA
                 auto now = std::chrono::high_resolution_clock::now();
@@ -1286,6 +1367,8 @@ int main(int argc, char* argv[]) {
                 cout << "      -> Saved. (ETA: " << formatDuration(eta) << ")" << endl;
                 projectContext += "\n// --- FILE: " + item.filename + " ---\n" + code + "\n";
             }
+            saveCache();
+            checkpoint.finish();
             cout << "[SERIES] All tasks completed." << endl;
             return 0;
         }
@@ -1303,16 +1386,77 @@ int main(int argc, char* argv[]) {
 
     if (dryRun) { cout << "--- CONTEXT PREVIEW ---\n" << aggregatedContext << endl; return 0; }
 
-    string tempSrc = "temp_build" + CURRENT_LANG.extension;
-    string tempBin = "temp_build.exe"; 
+    string tempSrc = sourceScratchPath("temp_build", CURRENT_LANG.extension);
+    string tempBin = scratchPath("temp_build.exe"); 
     string errorHistory = ""; 
 
     int passes = MAX_RETRIES;
 
+    // [NEW] Localized repair state: where each container landed in the last pass and which
+    // ones the compiler blamed
+    vector<BlockSpan> blockSpans;
+    set<string> repairIds;
+    string lastCode, lastDiagnostics;
+    int localRepairs = 0; // Consecutive; past MAX_LOCAL_REPAIRS the whole file is regenerated
+    const int MAX_LOCAL_REPAIRS = 2;
+    map<string, string> containerPrompts;
+    for (const auto& b : glupeBlocksIn(aggregatedContext)) containerPrompts[b.id] = b.content;
+
+    // Builds `src` into `bin` with -build or the language's compiler (nothing to run: success).
+    // Sources live in the scratch directory; C/C++ still find the project's "headers".
+    // Repair passes (`tiered`) of languages with a syntaxCmd are checked with it first and only
+    // built once it passes; a first pass is expected to build, so it goes straight to buildCmd.
+    // Both tiers reuse whatever warm state verify.hpp has for the language (PCH, incremental dir).
+    auto runBuild = [&](const string& src, const string& bin, bool tiered) {
+        CmdResult build;
+        if (!customBuildCmd.empty()) {
+            // [NEW] Custom build command execution
+            string cmd = customBuildCmd;
+            // Replace placeholders
+            size_t fPos = cmd.find("%FILE%");
+            if (fPos != string::npos) cmd.replace(fPos, 6, src);
+            size_t oPos = cmd.find("%OUT%");
+            if (oPos != string::npos) cmd.replace(oPos, 5, bin);
+            build = execCmd(cmd);
+        } else if (CURRENT_LANG.buildCmd.empty()) {
+            build.exitCode = 0;
+        } else {
+            // [NEW] Source, command and toolchain seen before: reuse the recorded result and binary
+            string artifact = artifactKey(sourceText(src), tiered && !CURRENT_LANG.syntaxCmd.empty());
+            if (loadArtifact(artifact, src, bin, build)) {
+                lock_guard<mutex> lock(LOG_MUTEX); // Speculative candidates build in parallel
+                cout << "   [CACHE] Build result reused (" << artifact.substr(0, 12) << ")." << endl;
+                return build;
+            }
+            [&]() {
+                if (residentCheck(src, build)) return;
+                string includes = (CURRENT_LANG.id == "cpp" || CURRENT_LANG.id == "c") ? " -iquote ." : "";
+                includes += warmBuildFlags(src);
+                if (tiered && !CURRENT_LANG.syntaxCmd.empty()) {
+                    string checkCmd = CURRENT_LANG.syntaxCmd;
+                    size_t dPos = checkCmd.find("%DIR%");
+                    if (dPos != string::npos) checkCmd.replace(dPos, 5, "\"" + fs::path(src).parent_path().string() + "\"");
+                    build = execCmd(checkCmd + " \"" + src + "\"" + includes);
+                    if (build.exitCode != 0) {
+                        log("VERIFY", "Syntax check failed; full build skipped.");
+                        return;
+                    }
+                }
+                string valCmd = CURRENT_LANG.buildCmd + " \"" + src + "\"" + includes;
+                if (CURRENT_LANG.producesBinary) valCmd += " -o \"" + bin + "\""; 
+                build = execCmd(valCmd);
+            }();
+            storeArtifact(artifact, src, bin, build);
+        }
+        return build;
+    };
+    bool speculative = SPECULATE > 1 && CURRENT_MODE == GenMode::CODE && !makeMode && !blindMode;
+
     // [FILL MODE] Skip global generation loop
     if (fillMode) {
         cout << "[FILL] Containers processed. Skipping global generation." << endl;
-        ofstream out(tempSrc); out << aggregatedContext; out.close();
+        // The filled file is this mode's output, so it stays in the project directory
+        ofstream out("temp_build" + CURRENT_LANG.extension); out << aggregatedContext; out.close();
         return 0;
     } else {
 
@@ -1331,6 +1475,7 @@ int main(int argc, char* argv[]) {
     }
 
     if (canDirectCompile) {
+        cronoTimer.phase("verify");
         cout << "[DIRECT] Attempting direct compilation..." << endl;
         string fileList = "";
         for (const auto& file : inputFiles) fileList += "\"" + file + "\" ";
@@ -1379,7 +1524,10 @@ int main(int argc, char* argv[]) {
         }
     }
     
-    for(int gen=1; gen<=passes; gen++) {
+    // Whole-file generation for pass `gen` into `code`. Returns main()'s exit code when the run
+    // ends here (API failure, make mode done), -1 to go on and verify `code`.
+    auto generateFile = [&](int gen, string& code, SpeculativeCandidate& speculated) -> int {
+        cronoTimer.phase("generate");
         if (makeMode) cout << "   [Pass " << gen << "] Architecting Project..." << endl;
         else cout << "   [Pass " << gen << "] Generating " << CURRENT_LANG.name << "..." << endl;
         
@@ -1440,31 +1588,68 @@ int main(int argc, char* argv[]) {
             prompt << "TASK: Create SINGLE " << CURRENT_LANG.name << " file.\n";
             prompt << "\n--- INPUT SOURCES ---\n" << aggregatedContext << "\n--- END SOURCES ---\n";
         }
-        if (!errorHistory.empty()) prompt << "\n[!] PREVIOUS ERRORS:\n" << errorHistory << "\n";
         prompt << "\nOUTPUT: Only code.";
+        // Last, so every fix pass extends the previous pass's prompt
+        if (!errorHistory.empty()) prompt << "\n[!] PREVIOUS ERRORS:\n" << errorHistory << "\n";
 
-        string code;
         bool apiSuccess = false;
         int apiRetries = 0;
 
-        while (apiRetries < MAX_RETRIES) {
-            string response = callAI(prompt.str());
+        // [NEW] Online validation: cancel the answer as soon as it is definitely broken
+        OutputInvariants rules;
+        rules.checkBlocks = (CURRENT_MODE == GenMode::CODE);
+        rules.blockIds = OutputInvariants::blockIdsIn(prompt.str());
+        rules.rejectPython = CURRENT_MODE == GenMode::CODE && !makeMode && (CURRENT_LANG.id == "cpp" || CURRENT_LANG.id == "c");
+        StreamCheck check = rules.checkBlocks ? makeStreamCheck(rules) : nullptr;
+
+        // [NEW] Speculative pass: K candidates at once, each built as soon as it arrives
+        if (speculative) {
+            vector<SpeculativeCandidate> candidates;
+            int pick = speculate(prompt.str(), SPECULATE, rules, [&](const string& candidate, const string& dir) {
+                string src = sourceScratchPath("temp_build_" + fs::path(dir).filename().string(), CURRENT_LANG.extension);
+                ofstream out(src); out << candidate; out.close();
+                CmdResult result = runBuild(src, (fs::path(dir) / fs::path(tempBin).filename()).string(), gen > 1);
+                std::error_code ec; fs::remove(src, ec);
+                result.output = replaceAll(result.output, src, tempSrc); // Diagnostics read as if for tempSrc
+                return result;
+            }, candidates);
+            // None built: continue with the one that has the fewest errors
+            if (pick < 0) {
+                size_t fewest = string::npos;
+                for (size_t i = 0; i < candidates.size(); i++) {
+                    if (!candidates[i].built) continue;
+                    size_t errors = diagnosticLines(candidates[i].build.output, tempSrc).size();
+                    if (errors < fewest) { fewest = errors; pick = (int)i; }
+                }
+            }
+            if (pick >= 0) {
+                speculated = candidates[pick];
+                code = speculated.answer;
+                apiSuccess = true;
+            } else {
+                cout << "   [SPECULATE] No usable candidate. Retrying with a single request..." << endl;
+            }
+        }
+
+        while (!apiSuccess && apiRetries < MAX_RETRIES) {
+            string response = callAI(prompt.str(), streamProgress(), check);
             code = extractCode(response);
         
-            if (code.find("ERROR:") == 0) { 
+            if (isStreamAbort(code)) {
+                string reason = code.substr(STREAM_ABORTED.size() + 2);
+                cout << "   [!] Generation aborted (Attempt " << (apiRetries + 1) << "/" << MAX_RETRIES << "): " << reason << endl;
+                cout << "       -> Retrying now..." << endl;
+                log("STREAM_ABORT", reason);
+                prompt << "\n[!] YOUR PREVIOUS ANSWER WAS CANCELLED: " << reason << ". Do not repeat this.\n";
+                apiRetries++;
+            } else if (code.find("ERROR:") == 0) { 
                 cout << "   [!] API Error (Attempt " << (apiRetries + 1) << "/" << MAX_RETRIES << "): " << code.substr(6) << endl; 
                 log("API_FAIL", code); 
                 if (code.find("JSON Parsing Failed") != string::npos) {
                      cout << "       (Hint: Check 'glupe config cloud-protocol'. Current: " << PROTOCOL << ", Provider URL: " << API_URL << ")" << endl;
                 }
-                
-                int waitTime = 5 * (apiRetries + 1);
-                if (code.find("Rate limit") != string::npos || code.find("429") != string::npos) {
-                    cout << "       -> Rate limit detected. Waiting " << waitTime << "s..." << endl;
-                } else {
-                    cout << "       -> Retrying in " << waitTime << "s..." << endl;
-                }
-                std::this_thread::sleep_for(std::chrono::seconds(waitTime));
+                if (isPermanentAIError(code)) break;
+                backoffBeforeRetry(apiRetries, code);
                 apiRetries++;
             } else {
                 apiSuccess = true;
@@ -1478,7 +1663,10 @@ int main(int argc, char* argv[]) {
         }
 
         // [NEW] Update Cache from AI Output
+        cronoTimer.phase("postprocess");
+        vector<GlupeBlock> generatedBlocks = glupeBlocksIn(code);
         code = updateCacheFromOutput(code);
+        string unprocessed = code;
 
         // [NEW] Tree Shaking (Post-Cache, Pre-Export)
         if (CURRENT_MODE == GenMode::CODE) {
@@ -1487,6 +1675,8 @@ int main(int argc, char* argv[]) {
 
         // [MAKE 2.0] Process exports in AI output (Generate files dynamically)
         code = processExports(code, fs::current_path());
+        if (code != unprocessed) for (auto& b : generatedBlocks) b.offset = string::npos; // Moved: fall back to searching
+        blockSpans = locateBlocks(code, generatedBlocks);
 
         if (makeMode) {
             // Check for content outside exports
@@ -1511,7 +1701,7 @@ int main(int argc, char* argv[]) {
                          }
                     }
                     // Update tempSrc extension
-                    tempSrc = "temp_build" + CURRENT_LANG.extension;
+                    tempSrc = sourceScratchPath("temp_build", CURRENT_LANG.extension);
                 }
             } else {
                 cout << "[MAKE] Generation complete. Files exported." << endl;
@@ -1562,6 +1752,28 @@ int main(int argc, char* argv[]) {
                 return 0;
             }
         }
+        return -1;
+    };
+
+    for(int gen=1; gen<=passes; gen++) {
+        string code;
+        bool repaired = false;
+        SpeculativeCandidate speculated; // The candidate this pass continues with, if it speculated
+        if (!repairIds.empty()) {
+            cronoTimer.phase("repair");
+            string ids;
+            for (const auto& id : repairIds) ids += (ids.empty() ? "" : ", ") + id;
+            cout << "   [Pass " << gen << "] Repairing container(s): " << ids << "..." << endl;
+            code = lastCode;
+            repaired = repairContainers(code, blockSpans, repairIds, lastDiagnostics, containerPrompts);
+            if (!repaired) cout << "   [REPAIR] Regenerating the whole file instead." << endl;
+            repairIds.clear();
+        }
+
+        if (!repaired) {
+            int status = generateFile(gen, code, speculated);
+            if (status >= 0) return status;
+        }
 
         ofstream out(tempSrc); out << code; out.close();
 
@@ -1583,6 +1795,7 @@ int main(int argc, char* argv[]) {
             return 0;
         }
 
+        cronoTimer.phase("verify");
         cout << "   Verifying..." << endl;
         
         // [FIX] Eliminar binario previo para evitar errores de bloqueo/permisos en Windows
@@ -1598,24 +1811,21 @@ int main(int argc, char* argv[]) {
         if (blindMode) {
             cout << "   [WARN] Blind Mode: Skipping verification." << endl;
             build.exitCode = 0;
-        } else if (!customBuildCmd.empty()) {
-            // [NEW] Custom build command execution
-            string cmd = customBuildCmd;
-            // Replace placeholders
-            size_t fPos = cmd.find("%FILE%");
-            if (fPos != string::npos) cmd.replace(fPos, 6, tempSrc);
-            size_t oPos = cmd.find("%OUT%");
-            if (oPos != string::npos) cmd.replace(oPos, 5, tempBin);
-            build = execCmd(cmd);
-        } else if (CURRENT_LANG.buildCmd.empty()) {
-            build.exitCode = 0;
+        } else if (speculated.built && speculated.code == code) {
+            // Post-processing left the candidate as it was built; reuse its result
+            build = speculated.build;
+            if (build.exitCode == 0 && CURRENT_LANG.producesBinary) {
+                std::error_code ec;
+                fs::copy_file(fs::path(speculated.dir) / fs::path(tempBin).filename(), tempBin, fs::copy_options::overwrite_existing, ec);
+                if (ec) build = runBuild(tempSrc, tempBin, false);
+            }
         } else {
-            string valCmd = CURRENT_LANG.buildCmd + " \"" + tempSrc + "\"";
-            if (CURRENT_LANG.producesBinary) valCmd += " -o \"" + tempBin + "\""; 
-            build = execCmd(valCmd);
+            build = runBuild(tempSrc, tempBin, gen > 1);
         }
+        if (speculative) { std::error_code ec; fs::remove_all(scratchPath("spec"), ec); }
         
         if (build.exitCode == 0) {
+            cronoTimer.phase("save");
             cout << "\nBUILD SUCCESSFUL: " << outputName << endl;
             std::error_code ec;
             bool saveSuccess = false;
@@ -1653,6 +1863,7 @@ int main(int argc, char* argv[]) {
             if (!saveSuccess) {
                 cerr << "[ERROR] Failed to save final output. File may be locked." << endl;
                 cout << "   Your build is preserved at: " << (CURRENT_LANG.producesBinary ? tempBin : tempSrc) << endl;
+                SCRATCH.keep = true;
                 return 1;
             }
             
@@ -1693,7 +1904,16 @@ int main(int argc, char* argv[]) {
                  errorHistory = "FATAL: It seems you wrote Python code instead of C++. STOP. Return ONLY valid C++ code.\n";
             } else {
                  errorHistory = "--- Error Pass " + to_string(gen) + " ---\n" + err;
+
+                 // [NEW] Errors only inside generated containers: regenerate just those next pass
+                 if (CURRENT_MODE == GenMode::CODE && !makeMode && localRepairs < MAX_LOCAL_REPAIRS) {
+                     repairIds = blocksOwningLines(blockSpans, diagnosticLines(err, tempSrc));
+                     if (!repairIds.empty()) { lastCode = code; lastDiagnostics = err; }
+                 }
+                 // [NEW] Another pass is coming: have its prologue compiled while the model works
+                 if (CURRENT_MODE == GenMode::CODE && customBuildCmd.empty()) warmUpToolchain(code);
             }
+            localRepairs = repairIds.empty() ? 0 : localRepairs + 1;
 
             if (isFatalError(err) && gen > 3) {
                 cerr << "\n[FATAL ERROR] Missing dependency/file detected. Aborting." << endl;
@@ -0,0 +1,107 @@
+#pragma once
+#include "utils.hpp"
+#include <condition_variable>
+#include <queue>
+
+// --- DEPENDENCY GRAPH ---
+// Nodes are indices (0..n-1). An edge dep -> node means `node` needs `dep` first.
+struct DependencyGraph {
+    vector<vector<size_t>> deps;
+    vector<vector<size_t>> dependents;
+
+    explicit DependencyGraph(size_t n = 0) : deps(n), dependents(n) {}
+
+    size_t size() const { return deps.size(); }
+
+    void addEdge(size_t dep, size_t node) {
+        if (dep == node) return;
+        if (find(deps[node].begin(), deps[node].end(), dep) != deps[node].end()) return;
+        deps[node].push_back(dep);
+        dependents[dep].push_back(node);
+    }
+
+    // Kahn's algorithm, ties broken by index so source order is kept where possible.
+    // Nodes stuck in a cycle are returned in `cyclic` and left out of the order.
+    vector<size_t> topoOrder(vector<size_t>* cyclic = nullptr) const {
+        vector<size_t> indeg(size());
+        for (size_t i = 0; i < size(); i++) indeg[i] = deps[i].size();
+        priority_queue<size_t, vector<size_t>, greater<size_t>> ready;
+        for (size_t i = 0; i < size(); i++) if (indeg[i] == 0) ready.push(i);
+
+        vector<size_t> order;
+        while (!ready.empty()) {
+            size_t n = ready.top(); ready.pop();
+            order.push_back(n);
+            for (size_t d : dependents[n]) if (--indeg[d] == 0) ready.push(d);
+        }
+        if (cyclic) {
+            cyclic->clear();
+            for (size_t i = 0; i < size(); i++) if (indeg[i] > 0) cyclic->push_back(i);
+        }
+        return order;
+    }
+
+    // Drops every edge between two nodes of `nodes` (used to break cycles so scheduling can proceed).
+    void dropEdgesWithin(const vector<size_t>& nodes) {
+        set<size_t> in(nodes.begin(), nodes.end());
+        for (size_t n : nodes) {
+            deps[n].erase(remove_if(deps[n].begin(), deps[n].end(), [&](size_t d) { return in.count(d) > 0; }), deps[n].end());
+            dependents[n].erase(remove_if(dependents[n].begin(), dependents[n].end(), [&](size_t d) { return in.count(d) > 0; }), dependents[n].end());
+        }
+    }
+
+    // All transitive dependents of the given roots (roots excluded unless reachable from another root).
+    set<size_t> descendants(const vector<size_t>& roots) const {
+        set<size_t> seen;
+        vector<size_t> stack;
+        for (size_t r : roots) for (size_t d : dependents[r]) stack.push_back(d);
+        while (!stack.empty()) {
+            size_t n = stack.back(); stack.pop_back();
+            if (!seen.insert(n).second) continue;
+            for (size_t d : dependents[n]) stack.push_back(d);
+        }
+        return seen;
+    }
+
+    // Runs task(i) for every node once all of its deps have finished, on up to `workers` threads.
+    // Independent subtrees proceed in parallel. The graph must be acyclic.
+    void run(int workers, const function<void(size_t)>& task) const {
+        size_t total = size();
+        if (total == 0) return;
+
+        mutex m;
+        condition_variable cv;
+        vector<size_t> pending(total);
+        priority_queue<size_t, vector<size_t>, greater<size_t>> ready;
+        for (size_t i = 0; i < total; i++) {
+            pending[i] = deps[i].size();
+            if (pending[i] == 0) ready.push(i);
+        }
+        size_t done = 0;
+
+        auto worker = [&]() {
+            while (true) {
+                size_t n;
+                {
+                    unique_lock<mutex> lock(m);
+                    cv.wait(lock, [&]() { return !ready.empty() || done == total; });
+                    if (ready.empty()) return;
+                    n = ready.top(); ready.pop();
+                }
+                task(n);
+                {
+                    lock_guard<mutex> lock(m);
+                    done++;
+                    for (size_t d : dependents[n]) if (--pending[d] == 0) ready.push(d);
+                }
+                cv.notify_all();
+            }
+        };
+
+        size_t n = min((size_t)max(1, workers), total);
+        vector<thread> pool;
+        for (size_t w = 1; w < n; w++) pool.emplace_back(worker);
+        worker();
+        for (auto& t : pool) t.join();
+    }
+};
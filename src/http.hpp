@@ -0,0 +1,476 @@
+#pragma once
+#include "utils.hpp"
+#include <mutex>
+#include <climits>
+#include <csignal>
+
+// TLS is on when the build finds OpenSSL (the Makefile and install scripts probe for it; make TLS=0 turns it off).
+// Without it, https:// endpoints go through curl.
+#ifdef GLUPE_TLS
+    #include <openssl/ssl.h>
+    #include <openssl/err.h>
+#endif
+
+#ifdef _WIN32
+    typedef SOCKET socket_t;
+    #define GLUPE_INVALID_SOCKET INVALID_SOCKET
+    #define closeSocket closesocket
+#else
+    #include <sys/socket.h>
+    #include <sys/types.h>
+    #include <sys/uio.h>
+    #include <netdb.h>
+    #include <netinet/in.h>
+    #include <netinet/tcp.h>
+    typedef int socket_t;
+    #define GLUPE_INVALID_SOCKET (-1)
+    #define closeSocket close
+#endif
+
+#ifdef MSG_NOSIGNAL
+    #define GLUPE_SEND_FLAGS MSG_NOSIGNAL // A server closing an idle keep-alive socket must not kill us with SIGPIPE
+#else
+    #define GLUPE_SEND_FLAGS 0
+#endif
+
+// --- HTTP TRANSPORT ---
+struct HttpUrl {
+    string scheme;
+    string host;
+    string port;
+    string target; // path + query
+    bool valid = false;
+};
+
+inline HttpUrl parseUrl(const string& url) {
+    HttpUrl u;
+    size_t sep = url.find("://");
+    if (sep == string::npos) return u;
+    u.scheme = url.substr(0, sep);
+    transform(u.scheme.begin(), u.scheme.end(), u.scheme.begin(), ::tolower);
+
+    size_t hostStart = sep + 3;
+    size_t pathStart = url.find_first_of("/?", hostStart);
+    string authority = url.substr(hostStart, pathStart == string::npos ? string::npos : pathStart - hostStart);
+    u.target = (pathStart == string::npos) ? "/" : url.substr(pathStart);
+    if (!u.target.empty() && u.target[0] == '?') u.target = "/" + u.target;
+
+    size_t colon = authority.rfind(':');
+    if (colon != string::npos && authority.find(']') == string::npos) {
+        u.host = authority.substr(0, colon);
+        u.port = authority.substr(colon + 1);
+    } else {
+        u.host = authority;
+        u.port = (u.scheme == "https") ? "443" : "80";
+    }
+    u.valid = !u.host.empty() && (u.scheme == "http" || u.scheme == "https");
+    return u;
+}
+
+struct HttpResponse {
+    int status = 0;
+    map<string, string> headers; // Lowercase keys
+    string body;
+    string error; // Transport failure (empty on success)
+    bool cancelled = false; // The body sink stopped the transfer
+};
+
+typedef vector<pair<string, string>> HttpHeaders;
+
+// Receives a 2xx response body piece by piece as it arrives; returning false cancels the transfer.
+typedef function<bool(const char* data, size_t len)> HttpBodySink;
+
+struct HttpTransport {
+    virtual ~HttpTransport() = default;
+    virtual HttpResponse request(const string& method, const string& url, const HttpHeaders& headers, const string& body) = 0;
+
+    // Transports that cannot stream deliver the whole body to the sink once it is complete.
+    virtual HttpResponse postStreaming(const string& url, const HttpHeaders& headers, const string& body, const HttpBodySink& sink) {
+        HttpResponse res = post(url, headers, body);
+        if (res.error.empty() && res.status >= 200 && res.status < 300 && !sink(res.body.data(), res.body.size())) res.cancelled = true;
+        return res;
+    }
+
+    HttpResponse post(const string& url, const HttpHeaders& headers, const string& body) { return request("POST", url, headers, body); }
+    HttpResponse get(const string& url) { return request("GET", url, {}, ""); }
+};
+
+// One TCP (optionally TLS) connection to a host. Kept alive between requests.
+struct HttpConnection {
+    socket_t fd = GLUPE_INVALID_SOCKET;
+    string key;
+#ifdef GLUPE_TLS
+    SSL* ssl = nullptr;
+#endif
+    string pending; // Bytes read past the end of the previous response
+
+    ~HttpConnection() {
+#ifdef GLUPE_TLS
+        if (ssl) { SSL_shutdown(ssl); SSL_free(ssl); }
+#endif
+        if (fd != GLUPE_INVALID_SOCKET) closeSocket(fd);
+    }
+
+    bool writeAll(const char* data, size_t len) {
+        while (len > 0) {
+#ifdef GLUPE_TLS
+            int n = ssl ? SSL_write(ssl, data, (int)min(len, (size_t)INT_MAX)) : (int)send(fd, data, (int)min(len, (size_t)INT_MAX), GLUPE_SEND_FLAGS);
+#else
+            int n = (int)send(fd, data, (int)min(len, (size_t)INT_MAX), GLUPE_SEND_FLAGS);
+#endif
+            if (n <= 0) return false;
+            data += n; len -= n;
+        }
+        return true;
+    }
+
+    // Header and body leave in one gather write on plain sockets (no Nagle stall between them)
+    bool writeRequest(const string& head, const string& body) {
+#if !defined(_WIN32)
+    #ifdef GLUPE_TLS
+        if (!ssl)
+    #endif
+        {
+            struct iovec iov[2] = { {(void*)head.data(), head.size()}, {(void*)body.data(), body.size()} };
+            size_t total = head.size() + body.size();
+            size_t sent = 0;
+            while (sent < total) {
+                struct msghdr msg{};
+                msg.msg_iov = iov;
+                msg.msg_iovlen = 2;
+                ssize_t n = sendmsg(fd, &msg, GLUPE_SEND_FLAGS);
+                if (n <= 0) return false;
+                sent += n;
+                size_t skip = n;
+                for (auto& v : iov) {
+                    size_t take = min(skip, v.iov_len);
+                    v.iov_base = (char*)v.iov_base + take; v.iov_len -= take; skip -= take;
+                }
+            }
+            return true;
+        }
+#endif
+        return writeAll(head.data(), head.size()) && writeAll(body.data(), body.size());
+    }
+
+    int readSome(char* buf, int len) {
+#ifdef GLUPE_TLS
+        if (ssl) return SSL_read(ssl, buf, len);
+#endif
+        return (int)recv(fd, buf, len, 0);
+    }
+};
+
+// A peer silent for this long fails the request instead of blocking its worker forever
+inline const int HTTP_IO_TIMEOUT_SECONDS = 600;
+
+// HTTP/1.1 client over raw sockets with a keep-alive pool per host:port.
+struct SocketTransport : HttpTransport {
+    mutex poolMutex;
+    map<string, vector<unique_ptr<HttpConnection>>> idle;
+#ifdef GLUPE_TLS
+    SSL_CTX* tlsCtx = nullptr;
+#endif
+
+    SocketTransport() {
+#ifdef _WIN32
+        WSADATA wsa;
+        WSAStartup(MAKEWORD(2, 2), &wsa);
+#endif
+#ifdef GLUPE_TLS
+        SSL_library_init();
+        SSL_load_error_strings();
+    #ifndef _WIN32
+        signal(SIGPIPE, SIG_IGN); // SSL_write has no MSG_NOSIGNAL equivalent
+    #endif
+        tlsCtx = SSL_CTX_new(TLS_client_method());
+        if (tlsCtx) {
+            SSL_CTX_set_default_verify_paths(tlsCtx);
+            SSL_CTX_set_verify(tlsCtx, SSL_VERIFY_PEER, nullptr);
+        }
+#endif
+    }
+
+    ~SocketTransport() override {
+        idle.clear();
+#ifdef GLUPE_TLS
+        if (tlsCtx) SSL_CTX_free(tlsCtx);
+#endif
+    }
+
+    static bool supports(const HttpUrl& u) {
+#ifdef GLUPE_TLS
+        return u.valid;
+#else
+        return u.valid && u.scheme == "http";
+#endif
+    }
+
+    unique_ptr<HttpConnection> connectTo(const HttpUrl& u, string& err) {
+        addrinfo hints{};
+        hints.ai_family = AF_UNSPEC;
+        hints.ai_socktype = SOCK_STREAM;
+        addrinfo* res = nullptr;
+        if (getaddrinfo(u.host.c_str(), u.port.c_str(), &hints, &res) != 0 || !res) {
+            err = "Could not resolve host " + u.host;
+            return nullptr;
+        }
+        auto conn = make_unique<HttpConnection>();
+        for (addrinfo* ai = res; ai; ai = ai->ai_next) {
+            socket_t fd = socket(ai->ai_family, ai->ai_socktype, ai->ai_protocol);
+            if (fd == GLUPE_INVALID_SOCKET) continue;
+            if (connect(fd, ai->ai_addr, (int)ai->ai_addrlen) == 0) { conn->fd = fd; break; }
+            closeSocket(fd);
+        }
+        freeaddrinfo(res);
+        if (conn->fd == GLUPE_INVALID_SOCKET) {
+            err = "Could not connect to " + u.host + ":" + u.port;
+            return nullptr;
+        }
+        int one = 1;
+        setsockopt(conn->fd, IPPROTO_TCP, TCP_NODELAY, (const char*)&one, sizeof(one));
+#ifdef _WIN32
+        DWORD timeout = HTTP_IO_TIMEOUT_SECONDS * 1000;
+#else
+        timeval timeout{HTTP_IO_TIMEOUT_SECONDS, 0};
+#endif
+        setsockopt(conn->fd, SOL_SOCKET, SO_RCVTIMEO, (const char*)&timeout, sizeof(timeout));
+        setsockopt(conn->fd, SOL_SOCKET, SO_SNDTIMEO, (const char*)&timeout, sizeof(timeout));
+#ifdef SO_NOSIGPIPE
+        setsockopt(conn->fd, SOL_SOCKET, SO_NOSIGPIPE, (const char*)&one, sizeof(one));
+#endif
+
+#ifdef GLUPE_TLS
+        if (u.scheme == "https") {
+            if (!tlsCtx) { err = "TLS context unavailable"; return nullptr; }
+            conn->ssl = SSL_new(tlsCtx);
+            SSL_set_fd(conn->ssl, (int)conn->fd);
+            SSL_set_tlsext_host_name(conn->ssl, u.host.c_str());
+            SSL_set1_host(conn->ssl, u.host.c_str());
+            if (SSL_connect(conn->ssl) != 1) {
+                err = "TLS handshake failed with " + u.host;
+                return nullptr;
+            }
+        }
+#endif
+        return conn;
+    }
+
+    unique_ptr<HttpConnection> acquire(const HttpUrl& u, const string& key, bool& reused, string& err) {
+        {
+            lock_guard<mutex> lock(poolMutex);
+            auto& list = idle[key];
+            if (!list.empty()) {
+                auto conn = move(list.back());
+                list.pop_back();
+                reused = true;
+                return conn;
+            }
+        }
+        reused = false;
+        auto conn = connectTo(u, err);
+        if (conn) conn->key = key;
+        return conn;
+    }
+
+    void release(unique_ptr<HttpConnection> conn) {
+        lock_guard<mutex> lock(poolMutex);
+        idle[conn->key].push_back(move(conn));
+    }
+
+    // Reads one full response. Returns false if the connection died before the status line; a body
+    // cut short (drop or timeout before its end) sets out.error, so it is never taken as an answer.
+    // With a sink, 2xx bodies are handed over as they arrive (still accumulated in out.body).
+    bool readResponse(HttpConnection& conn, HttpResponse& out, bool& keepAlive, const HttpBodySink* sink = nullptr) {
+        string& buf = conn.pending;
+        char chunk[16384];
+        size_t headerEnd;
+        while ((headerEnd = buf.find("\r\n\r\n")) == string::npos) {
+            int n = conn.readSome(chunk, sizeof(chunk));
+            if (n <= 0) return false;
+            buf.append(chunk, n);
+        }
+
+        // Status line + headers
+        size_t lineEnd = buf.find("\r\n");
+        string statusLine = buf.substr(0, lineEnd);
+        size_t sp = statusLine.find(' ');
+        if (sp != string::npos) out.status = atoi(statusLine.c_str() + sp + 1);
+        keepAlive = statusLine.compare(0, 8, "HTTP/1.1") == 0;
+
+        size_t p = lineEnd + 2;
+        while (p < headerEnd) {
+            size_t e = buf.find("\r\n", p);
+            string h = buf.substr(p, e - p);
+            size_t c = h.find(':');
+            if (c != string::npos) {
+                string k = h.substr(0, c);
+                transform(k.begin(), k.end(), k.begin(), ::tolower);
+                size_t v = h.find_first_not_of(" \t", c + 1);
+                out.headers[k] = (v == string::npos) ? "" : h.substr(v);
+            }
+            p = e + 2;
+        }
+        buf.erase(0, headerEnd + 4);
+
+        string connHdr = out.headers.count("connection") ? out.headers["connection"] : "";
+        transform(connHdr.begin(), connHdr.end(), connHdr.begin(), ::tolower);
+        if (connHdr == "close") keepAlive = false;
+        else if (connHdr == "keep-alive") keepAlive = true;
+
+        auto fill = [&](size_t need) {
+            while (buf.size() < need) {
+                int n = conn.readSome(chunk, sizeof(chunk));
+                if (n <= 0) return false;
+                buf.append(chunk, n);
+            }
+            return true;
+        };
+
+        if (!(out.status >= 200 && out.status < 300)) sink = nullptr;
+        // A cancelled response is abandoned mid-body, so its connection cannot be reused
+        auto deliver = [&](const char* data, size_t len) {
+            out.body.append(data, len);
+            if (sink && len > 0 && !(*sink)(data, len)) {
+                out.cancelled = true;
+                keepAlive = false;
+                return false;
+            }
+            return true;
+        };
+
+        auto truncated = [&]() {
+            keepAlive = false;
+            out.error = "Connection lost before the end of the response";
+            return true;
+        };
+
+        string te = out.headers.count("transfer-encoding") ? out.headers["transfer-encoding"] : "";
+        if (te.find("chunked") != string::npos) {
+            while (true) {
+                size_t crlf;
+                while ((crlf = buf.find("\r\n")) == string::npos) { if (!fill(buf.size() + 1)) return truncated(); }
+                size_t size = strtoul(buf.c_str(), nullptr, 16);
+                if (!fill(crlf + 2 + size + 2)) return truncated();
+                if (!deliver(buf.data() + crlf + 2, size)) return true;
+                buf.erase(0, crlf + 2 + size + 2);
+                if (size == 0) break; // Trailers are not used by any supported API
+            }
+        } else if (out.headers.count("content-length")) {
+            size_t len = strtoull(out.headers["content-length"].c_str(), nullptr, 10);
+            size_t got = 0;
+            while (true) {
+                size_t take = min(len - got, buf.size());
+                if (take > 0) {
+                    if (!deliver(buf.data(), take)) return true;
+                    buf.erase(0, take);
+                    got += take;
+                }
+                if (got == len) break;
+                int n = conn.readSome(chunk, sizeof(chunk));
+                if (n <= 0) return truncated();
+                buf.append(chunk, n);
+            }
+        } else {
+            // Body delimited by connection close
+            if (!deliver(buf.data(), buf.size())) return true;
+            buf.clear();
+            while (true) {
+                int n = conn.readSome(chunk, sizeof(chunk));
+                if (n < 0) return truncated(); // Error or timeout, not the close that ends the body
+                if (n == 0) break;
+                if (!deliver(chunk, n)) return true;
+            }
+            keepAlive = false;
+        }
+        return true;
+    }
+
+    HttpResponse request(const string& method, const string& url, const HttpHeaders& headers, const string& body) override {
+        return send(method, url, headers, body, nullptr);
+    }
+
+    HttpResponse postStreaming(const string& url, const HttpHeaders& headers, const string& body, const HttpBodySink& sink) override {
+        return send("POST", url, headers, body, &sink);
+    }
+
+    HttpResponse send(const string& method, const string& url, const HttpHeaders& headers, const string& body, const HttpBodySink* sink) {
+        HttpResponse out;
+        HttpUrl u = parseUrl(url);
+        if (!supports(u)) { out.error = "Unsupported URL: " + url; return out; }
+
+        string head;
+        head.reserve(256);
+        head += method + " " + u.target + " HTTP/1.1\r\n";
+        head += "Host: " + u.host + ((u.port == "80" || u.port == "443") ? "" : ":" + u.port) + "\r\n";
+        head += "Connection: keep-alive\r\n";
+        head += "Accept: application/json\r\n";
+        for (const auto& [k, v] : headers) head += k + ": " + v + "\r\n";
+        if (method != "GET" || !body.empty()) head += "Content-Length: " + to_string(body.size()) + "\r\n";
+        head += "\r\n";
+
+        string key = u.scheme + "://" + u.host + ":" + u.port;
+
+        // A pooled connection may have been closed by the server while idle; retry once on a fresh one.
+        for (int attempt = 0; attempt < 2; attempt++) {
+            bool reused = false;
+            string err;
+            auto conn = acquire(u, key, reused, err);
+            if (!conn) { out.error = err; return out; }
+
+            if (VERBOSE_MODE) log("HTTP", method + " " + url + (reused ? " (keep-alive)" : " (new connection)"));
+
+            bool keepAlive = false;
+            HttpResponse res;
+            if (!conn->writeRequest(head, body) || !readResponse(*conn, res, keepAlive, sink)) {
+                if (reused) continue;
+                out.error = "Connection to " + u.host + ":" + u.port + " failed";
+                return out;
+            }
+            if (keepAlive) release(move(conn));
+            return res;
+        }
+        out.error = "Connection to " + u.host + ":" + u.port + " failed";
+        return out;
+    }
+};
+
+// Fallback for endpoints the socket client cannot reach (https:// without TLS=1).
+// Buffers whole responses, so streamed answers arrive all at once.
+struct CurlTransport : HttpTransport {
+    HttpResponse request(const string& method, const string& url, const HttpHeaders& headers, const string& body) override {
+        HttpResponse out;
+        string hdrs;
+        for (const auto& [k, v] : headers) hdrs += " -H \"" + k + ": " + v + "\"";
+
+        string tmp;
+        if (!body.empty()) {
+            static atomic<int> requests{0};
+            tmp = scratchPath("request_" + to_string(requests++) + ".json");
+            ofstream file(tmp, ios::binary);
+            file << body;
+        }
+        string cmd = "curl -s -X " + method + hdrs + (tmp.empty() ? "" : " -d @" + tmp) + " -w \"\\n%{http_code}\" \"" + url + "\"";
+        CmdResult res = execCmd(cmd);
+        if (!tmp.empty()) remove(tmp.c_str());
+
+        size_t nl = res.output.find_last_of('\n');
+        if (nl == string::npos) {
+            out.error = res.output.empty() ? "curl failed (exit " + to_string(res.exitCode) + ")" : res.output;
+            return out;
+        }
+        out.status = atoi(res.output.c_str() + nl + 1);
+        out.body = res.output.substr(0, nl);
+        if (out.status == 0) out.error = "curl could not reach " + url;
+        return out;
+    }
+};
+
+inline SocketTransport& socketTransport() { static SocketTransport t; return t; }
+inline CurlTransport& curlTransport() { static CurlTransport t; return t; }
+
+// Picks the in-process client when it can serve the URL, curl otherwise.
+inline HttpTransport& transportFor(const string& url) {
+    if (SocketTransport::supports(parseUrl(url))) return socketTransport();
+    return curlTransport();
+}
@@ -8,18 +8,21 @@ struct LangProfile {
     string id; string name; string extension;  
     string versionCmd; string buildCmd; bool producesBinary;
     string checkCmd; 
+    // Cheap verification tier run before buildCmd (parse/type-check, no codegen or link); a pass
+    // that fails here never pays for the full build. %DIR% is the source's directory.
+    string syntaxCmd;
 };
 
 inline map<string, LangProfile> LANG_DB = {
-    {"cpp",  {"cpp", "C++", ".cpp", "g++ --version", "g++ -std=gnu++17", true}},
-    {"cc",   {"cpp", "C++", ".cc",  "g++ --version", "g++ -std=gnu++17", true}},
-    {"cxx",  {"cpp", "C++", ".cxx", "g++ --version", "g++ -std=gnu++17", true}},
-    {"hpp",  {"cpp", "C++", ".hpp", "g++ --version", "g++ -std=gnu++17", true}},
-    {"hh",   {"cpp", "C++", ".hh",  "g++ --version", "g++ -std=gnu++17", true}},
-    {"c",    {"c",   "C",   ".c",   "gcc --version", "gcc", true}},
-    {"h",    {"c",   "C",   ".h",   "gcc --version", "gcc", true}},
-    {"rust", {"rust","Rust",".rs",  "rustc --version", "rustc", true}}, 
-    {"go",   {"go",  "Go",  ".go",  "go version", "go build", true}},
+    {"cpp",  {"cpp", "C++", ".cpp", "g++ --version", "g++ -std=gnu++17", true, "", "g++ -std=gnu++17 -fsyntax-only"}},
+    {"cc",   {"cpp", "C++", ".cc",  "g++ --version", "g++ -std=gnu++17", true, "", "g++ -std=gnu++17 -fsyntax-only"}},
+    {"cxx",  {"cpp", "C++", ".cxx", "g++ --version", "g++ -std=gnu++17", true, "", "g++ -std=gnu++17 -fsyntax-only"}},
+    {"hpp",  {"cpp", "C++", ".hpp", "g++ --version", "g++ -std=gnu++17", true, "", "g++ -std=gnu++17 -fsyntax-only"}},
+    {"hh",   {"cpp", "C++", ".hh",  "g++ --version", "g++ -std=gnu++17", true, "", "g++ -std=gnu++17 -fsyntax-only"}},
+    {"c",    {"c",   "C",   ".c",   "gcc --version", "gcc", true, "", "gcc -fsyntax-only"}},
+    {"h",    {"c",   "C",   ".h",   "gcc --version", "gcc", true, "", "gcc -fsyntax-only"}},
+    {"rust", {"rust","Rust",".rs",  "rustc --version", "rustc", true, "", "rustc --emit=metadata --out-dir %DIR%"}},
+    {"go",   {"go",  "Go",  ".go",  "go version", "go build", true, "", "gofmt -l -e"}},
     {"py",   {"py",  "Python", ".py", "python --version", "python -m py_compile", false, "python"}},
     {"js",   {"js",  "JavaScript", ".js", "node --version", "node -c", false}},
     {"ts",   {"ts",  "TypeScript", ".ts", "tsc --version", "tsc --noEmit", false}},
@@ -30,14 +33,14 @@ inline map<string, LangProfile> LANG_DB = {
     {"lua",  {"lua", "Lua", ".lua", "lua -v", "luac -p", false}},
     {"pl",   {"pl",  "Perl", ".pl", "perl -v", "perl -c", false}},
     {"sh",   {"sh",  "Bash", ".sh", "bash --version", "bash -n", false}},
-    {"swift",{"swift","Swift",".swift","swift --version", "swiftc", true}},
+    {"swift",{"swift","Swift",".swift","swift --version", "swiftc", true, "", "swiftc -typecheck"}},
     {"kt",   {"kt",  "Kotlin", ".kt", "kotlinc -version", "kotlinc", false}},
     {"scala",{"scala","Scala",".scala","scala -version", "scalac", false}},
-    {"hs",   {"hs",  "Haskell", ".hs", "ghc --version", "ghc", true}},
+    {"hs",   {"hs",  "Haskell", ".hs", "ghc --version", "ghc", true, "", "ghc -fno-code"}},
     {"jl",   {"jl",  "Julia", ".jl", "julia --version", "julia", false}},
     {"dart", {"dart","Dart",".dart","dart --version", "dart compile exe", true}},
-    {"zig",  {"zig", "Zig", ".zig", "zig version", "zig build-exe", true}},
-    {"nim",  {"nim", "Nim", ".nim", "nim --version", "nim c", true}},
+    {"zig",  {"zig", "Zig", ".zig", "zig version", "zig build-exe", true, "", "zig ast-check"}},
+    {"nim",  {"nim", "Nim", ".nim", "nim --version", "nim c", true, "", "nim check"}},
     {"r",    {"r",   "R",   ".r",   "R --version", "Rscript", false}},
     {"html", {"html", "HTML", ".html", "", "", false}},
     {"css",  {"css",  "CSS",  ".css",  "", "", false}},
@@ -0,0 +1,278 @@
+#pragma once
+#include "common.hpp"
+#include <cstring>
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+// --- GLUPE LEXER ---
+// A single left-to-right pass that finds every container, variable and malformed inline header,
+// with byte offsets and line numbers. validateContainers, processInputWithCache, stripTemplates
+// and `glupe edit` consume this token stream instead of re-scanning the text themselves.
+enum class GlupeTokenKind {
+    CONTAINER,        // $$ id (params) -> parents { ... }$$   or   $ id -> parents { ... } $
+    ANONYMOUS,        // $${ ... }$$   or   $ { ... } $
+    VAR_PERSISTENT,   // $$: id -> value
+    VAR_EPHEMERAL,    // $: id -> value
+    CONSTANT,         // $CONST: id -> value
+    MALFORMED_INLINE  // $ id { ... with no closing brace on the same line
+};
+
+struct GlupeToken {
+    GlupeTokenKind kind = GlupeTokenKind::CONTAINER;
+    size_t start = 0;        // Offset of the opening '$'
+    size_t end = 0;          // Where scanning resumes: past the closer, the line end for variables
+    size_t contentStart = 0; // Prompt (containers) or value (variables)
+    size_t contentEnd = 0;   // For MALFORMED_INLINE: end of the offending line
+    int line = 1;            // 1-based line of `start`
+    bool isBlock = false;
+    bool isAbstract = false;
+    bool closed = true;      // False when the closer was never found
+    string id;
+    vector<string> parents;
+    vector<string> params;
+};
+
+inline bool glupeSpace(char c) { return isspace(static_cast<unsigned char>(c)) != 0; }
+
+// Offset of the next `c` in s[from, n), or string::npos. Compares 16 bytes per step with SSE2
+// (on by default on x86-64); other targets fall back to memchr.
+inline size_t glupeFindByte(const char* s, size_t from, size_t n, char c) {
+    if (from >= n) return string::npos;
+#ifdef __SSE2__
+    const __m128i needle = _mm_set1_epi8(c);
+    size_t i = from;
+    for (; i + 16 <= n; i += 16) {
+        int mask = _mm_movemask_epi8(_mm_cmpeq_epi8(_mm_loadu_si128((const __m128i*)(s + i)), needle));
+        if (mask) return i + __builtin_ctz((unsigned)mask);
+    }
+    for (; i < n; i++) if (s[i] == c) return i;
+    return string::npos;
+#else
+    const void* hit = memchr(s + from, c, n - from);
+    return hit ? (size_t)((const char*)hit - s) : string::npos;
+#endif
+}
+
+// Containers are lexed with the same grammar processInputWithCache always used. Scanning resumes
+// after a container's closer, so prompts are never mistaken for syntax; anonymous containers are
+// the exception (their bodies may hold named containers) and are re-entered after the '{'.
+inline vector<GlupeToken> lexGlupe(const string& code) {
+    vector<GlupeToken> tokens;
+    const size_t n = code.length();
+    const char* s = code.data();
+
+    // Token starts only move forward, so line numbers and line ends are tracked incrementally
+    int line = 1;
+    size_t counted = 0;
+    auto lineAt = [&](size_t p) {
+        line += (int)count(s + counted, s + p, '\n');
+        counted = p;
+        return line;
+    };
+    size_t cachedFrom = 1, cachedEnd = 0; // Empty until the first lookup
+    auto lineEndAt = [&](size_t p) {
+        if (p < cachedFrom || p > cachedEnd) {
+            const void* nl = memchr(s + p, '\n', n - p);
+            cachedFrom = p;
+            cachedEnd = nl ? (const char*)nl - s : n;
+        }
+        return cachedEnd;
+    };
+    auto findOnLine = [&](char c, size_t from, size_t to) -> size_t {
+        if (from >= to) return string::npos;
+        const void* hit = memchr(s + from, c, to - from);
+        return hit ? (const char*)hit - s : string::npos;
+    };
+    // `}` followed (after spaces) by `$` on this line; returns the '}' and sets `after` past the '$'
+    auto findInlineClose = [&](size_t from, size_t lineEnd, size_t& after) -> size_t {
+        while (from < lineEnd) {
+            size_t closeB = findOnLine('}', from, lineEnd);
+            if (closeB == string::npos) break;
+            size_t check = closeB + 1;
+            while (check < lineEnd && glupeSpace(s[check])) check++;
+            if (check < lineEnd && s[check] == '$') { after = check + 1; return closeB; }
+            from = closeB + 1;
+        }
+        return string::npos;
+    };
+
+    size_t pos = 0;
+    while (pos < n) {
+        size_t start = glupeFindByte(s, pos, n, '$');
+        if (start == string::npos) break;
+
+        GlupeToken tok;
+        tok.start = start;
+        bool isVar = false;
+        bool isInline = false;
+        size_t scan = 0;
+
+        if (start + 1 < n && s[start+1] == '$') {
+            if (start + 2 < n && s[start+2] == ':') { tok.kind = GlupeTokenKind::VAR_PERSISTENT; isVar = true; scan = start + 3; }
+            else { tok.isBlock = true; scan = start + 2; }
+        } else if (start + 1 < n && s[start+1] == ':') {
+            tok.kind = GlupeTokenKind::VAR_EPHEMERAL; isVar = true; scan = start + 2;
+        } else if (code.compare(start, 7, "$CONST:") == 0) {
+            tok.kind = GlupeTokenKind::CONSTANT; isVar = true; scan = start + 7;
+        } else {
+            // Inline container: $ ... { ... } ... $ on one line
+            size_t lineEnd = lineEndAt(start);
+            size_t openB = findOnLine('{', start, lineEnd);
+            size_t after = 0;
+            if (openB != string::npos && findInlineClose(openB + 1, lineEnd, after) != string::npos) {
+                isInline = true;
+                scan = start + 1;
+            }
+        }
+
+        // Variables and constants: $...: ID -> VALUE \n
+        if (isVar) {
+            while (scan < n && glupeSpace(s[scan])) scan++;
+            size_t idStart = scan;
+            while (scan < n && (isalnum(static_cast<unsigned char>(s[scan])) || s[scan] == '_')) scan++;
+            tok.id = code.substr(idStart, scan - idStart);
+            while (scan < n && glupeSpace(s[scan])) scan++;
+            if (scan + 1 < n && s[scan] == '-' && s[scan+1] == '>') scan += 2;
+            while (scan < n && glupeSpace(s[scan]) && s[scan] != '\n') scan++;
+
+            const void* nl = memchr(s + scan, '\n', n - scan);
+            size_t lineEnd = nl ? (const char*)nl - s : n;
+            size_t valEnd = lineEnd;
+            while (valEnd > scan && (s[valEnd-1] == ' ' || s[valEnd-1] == '\t' || s[valEnd-1] == '\r')) valEnd--;
+            tok.contentStart = scan;
+            tok.contentEnd = valEnd;
+            tok.end = lineEnd;
+            tok.line = lineAt(start);
+            tokens.push_back(move(tok));
+            pos = lineEnd;
+            continue;
+        }
+
+        if (!tok.isBlock && !isInline) {
+            // A lone '$' that still looks like an inline header ($ {, $ id {, $ id(...) {, $ id -> p {)
+            // but has no closing brace on its line is reported so the user gets a line number.
+            size_t lineEnd = lineEndAt(start);
+            size_t check = start + 1;
+            while (check < lineEnd && glupeSpace(s[check])) check++;
+            size_t bracePos = string::npos;
+            if (check < lineEnd && s[check] == '{') {
+                bracePos = check;
+            } else {
+                while (check < lineEnd && (isalnum(static_cast<unsigned char>(s[check])) || s[check] == '_')) check++;
+                while (check < lineEnd && glupeSpace(s[check])) check++;
+                if (check < lineEnd && s[check] == '(') {
+                    size_t closeP = findOnLine(')', check, lineEnd);
+                    if (closeP != string::npos) {
+                        check = closeP + 1;
+                        while (check < lineEnd && glupeSpace(s[check])) check++;
+                    }
+                }
+                if (check < lineEnd && s[check] == '{') {
+                    bracePos = check;
+                } else if (check + 1 < lineEnd && s[check] == '-' && s[check+1] == '>') {
+                    bracePos = findOnLine('{', check + 2, lineEnd);
+                }
+            }
+            if (bracePos != string::npos && findOnLine('}', bracePos, lineEnd) == string::npos) {
+                tok.kind = GlupeTokenKind::MALFORMED_INLINE;
+                tok.contentStart = start;
+                tok.contentEnd = lineEnd;
+                tok.end = start + 1;
+                tok.line = lineAt(start);
+                tokens.push_back(move(tok));
+            }
+            pos = start + 1;
+            continue;
+        }
+
+        size_t sigilEnd = scan;
+        size_t lineEnd = tok.isBlock ? n : lineEndAt(start);
+
+        // Finds the closer for a body starting at `from`; false when it is missing
+        auto close = [&](size_t from) {
+            size_t end = string::npos, nextPos = 0;
+            if (tok.isBlock) {
+                end = code.find("}$$", from);
+                if (end != string::npos) nextPos = end + 3;
+            } else {
+                end = findInlineClose(from, lineEnd, nextPos);
+            }
+            tok.contentStart = from;
+            tok.closed = (end != string::npos);
+            tok.contentEnd = tok.closed ? end : from;
+            tok.end = tok.closed ? nextPos : sigilEnd;
+            return tok.closed;
+        };
+
+        while (scan < n && glupeSpace(s[scan])) scan++;
+
+        if (scan + 8 <= n && code.compare(scan, 8, "ABSTRACT") == 0 && (scan + 8 == n || glupeSpace(s[scan+8]))) {
+            tok.isAbstract = true;
+            scan += 8;
+            while (scan < n && glupeSpace(s[scan])) scan++;
+        }
+
+        if (scan < n && s[scan] == '{') {
+            tok.kind = GlupeTokenKind::ANONYMOUS;
+            close(scan + 1);
+            tok.line = lineAt(start);
+            tokens.push_back(move(tok));
+            pos = scan + 1;
+            continue;
+        }
+
+        // Named container: id stops at whitespace, '{', '(' or '->'
+        size_t idStart = scan;
+        while (scan < n && !glupeSpace(s[scan]) && s[scan] != '{' && s[scan] != '(' && !(s[scan] == '-' && scan + 1 < n && s[scan+1] == '>')) {
+            scan++;
+        }
+        if (scan == idStart) { pos = sigilEnd; continue; }
+        tok.id = code.substr(idStart, scan - idStart);
+
+        // Parameters (context injection): id(a, b)
+        if (scan < n && s[scan] == '(') {
+            size_t pStart = scan + 1;
+            size_t pEnd = code.find(')', pStart);
+            if (pEnd != string::npos) {
+                stringstream ss(code.substr(pStart, pEnd - pStart));
+                string segment;
+                while (getline(ss, segment, ',')) {
+                    segment.erase(0, segment.find_first_not_of(" \t"));
+                    segment.erase(segment.find_last_not_of(" \t") + 1);
+                    if (!segment.empty()) tok.params.push_back(segment);
+                }
+                scan = pEnd + 1;
+            }
+        }
+
+        // Inheritance: -> parent1, parent2
+        size_t brace = scan;
+        while (brace < n && glupeSpace(s[brace])) brace++;
+        if (brace + 1 < n && s[brace] == '-' && s[brace+1] == '>') {
+            size_t pScan = brace + 2;
+            while (pScan < n) {
+                while (pScan < n && glupeSpace(s[pScan])) pScan++;
+                if (pScan >= n || s[pScan] == '{') break;
+
+                size_t pStart = pScan;
+                while (pScan < n && !glupeSpace(s[pScan]) && s[pScan] != ',' && s[pScan] != '{') pScan++;
+                if (pScan > pStart) tok.parents.push_back(code.substr(pStart, pScan - pStart));
+
+                while (pScan < n && glupeSpace(s[pScan])) pScan++;
+                if (pScan < n && s[pScan] == ',') pScan++;
+                else if (pScan < n && s[pScan] == '{') break;
+            }
+            brace = pScan;
+        }
+
+        while (brace < n && glupeSpace(s[brace])) brace++;
+        if (brace >= n || s[brace] != '{') { pos = sigilEnd; continue; }
+
+        close(brace + 1);
+        tok.line = lineAt(start);
+        pos = tok.end;
+        tokens.push_back(move(tok));
+    }
+    return tokens;
+}
@@ -2,151 +2,284 @@
 #include "utils.hpp"
 #include "languages.hpp"
 #include "cache.hpp"
+#include "lexer.hpp"
+
+// Trimmed comment body looks like a container: $ ... $ (a $$ ... $$ block also matches)
+inline bool isCommentedContainer(const char* s, size_t from, size_t to) {
+    while (from < to && (s[from] == ' ' || s[from] == '\t' || s[from] == '\r' || s[from] == '\n')) from++;
+    while (to > from && (s[to-1] == ' ' || s[to-1] == '\t' || s[to-1] == '\r' || s[to-1] == '\n')) to--;
+    return from < to && s[from] == '$' && s[to-1] == '$';
+}
+
+// Copies code into a fresh buffer, unwrapping/dropping comments that start with `opener`
+// (two chars, or one when opener[1] == 0). `closer` is empty for line comments.
+//   keepEmpty:   whitespace-only comments stay (else they are dropped)
+//   dropOthers:  non-container comments are dropped (else they stay verbatim)
+inline string rewriteGlupeComments(const string& code, const char* opener, const char* closer, bool keepEmpty, bool dropOthers) {
+    const char* s = code.data();
+    const size_t n = code.size();
+    const size_t openLen = opener[1] ? 2 : 1;
+    const size_t closeLen = strlen(closer);
+
+    string out;
+    out.reserve(n);
+    size_t copied = 0; // code[copied, pos) is still owed to `out`
+    size_t pos = 0;
+    while ((pos = glupeFindByte(s, pos, n, opener[0])) != string::npos) {
+        if (openLen == 2 && (pos + 1 >= n || s[pos+1] != opener[1])) { pos++; continue; }
+
+        size_t bodyStart = pos + openLen;
+        size_t bodyEnd, next;
+        if (closeLen) {
+            bodyEnd = code.find(closer, bodyStart);
+            if (bodyEnd == string::npos) break; // Unclosed comment, stop processing
+            next = bodyEnd + closeLen;
+        } else {
+            bodyEnd = glupeFindByte(s, bodyStart, n, '\n');
+            if (bodyEnd == string::npos) bodyEnd = n;
+            next = bodyEnd;
+        }
+
+        bool empty = true;
+        for (size_t k = bodyStart; k < bodyEnd && empty; k++) empty = (s[k] == ' ' || s[k] == '\t' || s[k] == '\r' || s[k] == '\n');
+
+        bool unwrap = !empty && isCommentedContainer(s, bodyStart, bodyEnd);
+        if (unwrap || (empty ? !keepEmpty : dropOthers)) {
+            out.append(s + copied, pos - copied);
+            if (unwrap) out.append(s + bodyStart, bodyEnd - bodyStart);
+            copied = next;
+        }
+        pos = next;
+    }
+    out.append(s + copied, n - copied);
+    return out;
+}
 
 // [NEW] Pre-processor to extract glupe syntax from comments
+// Four stages, each reading the previous one's output: /* */, //, %{ }%, %. Each is a single
+// forward copy into a fresh buffer, so the whole thing is linear in the file size. Stages whose
+// sentinel bytes are absent are skipped; without a '$' only %{ }% removal can change anything.
 inline string decommentGlupeSyntax(const string& code) {
+    bool hasDollar = glupeFindByte(code.data(), 0, code.size(), '$') != string::npos;
+    bool hasSlash = hasDollar && glupeFindByte(code.data(), 0, code.size(), '/') != string::npos;
+    bool hasPercent = glupeFindByte(code.data(), 0, code.size(), '%') != string::npos;
+
     string processedCode = code;
-    size_t pos = 0;
 
     // --- Handle block comments: /* ... */ ---
-    pos = 0;
-    while ((pos = processedCode.find("/*", pos)) != string::npos) {
-        size_t endPos = processedCode.find("*/", pos + 2);
-        if (endPos == string::npos) break; // Unclosed comment, stop processing
+    if (hasSlash) processedCode = rewriteGlupeComments(processedCode, "/*", "*/", true, false);
 
-        string commentContent = processedCode.substr(pos + 2, endPos - (pos + 2));
-        
-        string trimmedContent = commentContent;
-        size_t first = trimmedContent.find_first_not_of(" \t\r\n");
-        if (first == string::npos) { // Empty or whitespace-only comment
-            pos = endPos + 2;
-            continue;
-        }
-        trimmedContent.erase(0, first);
-        size_t last = trimmedContent.find_last_not_of(" \t\r\n");
-        if (last != string::npos) trimmedContent.erase(last + 1);
+    // --- Handle line comments: // ... ---
+    if (hasSlash) processedCode = rewriteGlupeComments(processedCode, "//", "", true, false);
 
-        bool isBlockContainer = (trimmedContent.rfind("$$", 0) == 0 && trimmedContent.rfind("$$") == trimmedContent.length() - 2);
-        bool isInlineContainer = (trimmedContent.rfind("$", 0) == 0 && trimmedContent.rfind("$") == trimmedContent.length() - 1);
+    // --- Handle Glupe block comments: %{ ... }% --- (non-container ones are removed)
+    if (hasPercent) processedCode = rewriteGlupeComments(processedCode, "%{", "}%", false, true);
 
-        if (isBlockContainer || isInlineContainer) {
-            processedCode.replace(pos, (endPos + 2) - pos, commentContent);
-            pos += commentContent.length();
-        } else {
-            pos = endPos + 2;
-        }
-    }
+    // --- Handle Glupe line comments: % ... ---
+    if (hasPercent && hasDollar) processedCode = rewriteGlupeComments(processedCode, "%", "", true, false);
 
-    // --- Handle line comments: // ... ---
-    pos = 0;
-    while ((pos = processedCode.find("//", pos)) != string::npos) {
-        size_t endOfLine = processedCode.find('\n', pos);
-        if (endOfLine == string::npos) endOfLine = processedCode.length();
+    return processedCode;
+}
 
-        string commentContent = processedCode.substr(pos + 2, endOfLine - (pos + 2));
-        
-        string trimmedContent = commentContent;
-        size_t first = trimmedContent.find_first_not_of(" \t\r\n");
-        if (first == string::npos) { // Empty or whitespace-only comment
-            pos = endOfLine;
-            if (pos >= processedCode.length()) break;
-            continue;
-        }
-        trimmedContent.erase(0, first);
-        size_t last = trimmedContent.find_last_not_of(" \t\r\n");
-        if (last != string::npos) trimmedContent.erase(last + 1);
+// --- MODULE CACHE ---
+// Resolved expansion of every imported file, keyed by canonical path and kept in
+// glupe_cache/modules.json (expansions live in the content-addressed store). An entry is reused
+// while the file's mtime/size (or, failing that, content digest) match and every module it
+// imports still resolves to the same expansion, so unchanged import trees are only stat()ed.
+struct ModuleImport {
+    string target;    // basePath / fname as written
+    string canonical; // "" when the import was not found
+    string expansion; // Digest of the imported module's expansion
+};
 
-        bool isInlineContainer = (trimmedContent.rfind("$", 0) == 0 && trimmedContent.rfind("$") == trimmedContent.length() - 1);
+struct ModuleEntry {
+    long long mtime = 0;
+    uintmax_t size = 0;
+    string digest;    // Raw file content
+    string expansion; // Resolved text, in the content-addressed store
+    vector<ModuleImport> imports;
+};
 
-        if (isInlineContainer) {
-            processedCode.replace(pos, endOfLine - pos, commentContent);
-            pos += commentContent.length();
-        } else {
-            pos = endOfLine;
-            if (pos >= processedCode.length()) break;
+inline map<string, ModuleEntry> MODULE_CACHE;
+inline map<string, string> MODULE_VERIFIED; // Checked this run: canonical path -> expansion digest ("" = stale)
+inline mutex MODULE_CACHE_MUTEX;
+inline bool MODULE_CACHE_LOADED = false;
+inline bool MODULE_CACHE_DIRTY = false;
+inline atomic<int> IMPORT_WORKERS{0}; // Extra threads currently loading sibling imports
+
+inline string moduleIndexPath() { return CACHE_DIR + "/modules.json"; }
+
+inline void loadModuleCache() {
+    lock_guard<mutex> lock(MODULE_CACHE_MUTEX);
+    if (MODULE_CACHE_LOADED) return;
+    MODULE_CACHE_LOADED = true;
+    ifstream f(moduleIndexPath());
+    if (!f.is_open()) return;
+    json j = json::parse(f, nullptr, false);
+    if (j.is_discarded() || !j.contains("modules")) return;
+    for (auto& [path, m] : j["modules"].items()) {
+        ModuleEntry e;
+        e.mtime = m.value("mtime", 0LL);
+        e.size = m.value("size", (uintmax_t)0);
+        e.digest = m.value("digest", "");
+        e.expansion = m.value("expansion", "");
+        if (m.contains("imports")) {
+            for (auto& imp : m["imports"]) e.imports.push_back({imp.value("target", ""), imp.value("canonical", ""), imp.value("expansion", "")});
         }
+        MODULE_CACHE[path] = e;
     }
+}
 
-    // --- Handle Glupe block comments: %{ ... }% ---
-    pos = 0;
-    while ((pos = processedCode.find("%{", pos)) != string::npos) {
-        size_t endPos = processedCode.find("}%", pos + 2);
-        if (endPos == string::npos) break; // Unclosed comment
+inline void saveModuleCache() {
+    lock_guard<mutex> lock(MODULE_CACHE_MUTEX);
+    if (!MODULE_CACHE_DIRTY) return;
+    json modules = json::object();
+    for (const auto& [path, e] : MODULE_CACHE) {
+        json imports = json::array();
+        for (const auto& imp : e.imports) imports.push_back({ {"target", imp.target}, {"canonical", imp.canonical}, {"expansion", imp.expansion} });
+        modules[path] = { {"mtime", e.mtime}, {"size", e.size}, {"digest", e.digest}, {"expansion", e.expansion}, {"imports", imports} };
+    }
+    std::error_code ec;
+    fs::create_directories(CACHE_DIR, ec);
+    string tmp = moduleIndexPath() + ".tmp" + to_string(processId());
+    {
+        ofstream f(tmp);
+        f << json{ {"version", 1}, {"modules", modules} }.dump();
+    }
+    fs::rename(tmp, moduleIndexPath(), ec);
+    if (!ec) MODULE_CACHE_DIRTY = false;
+}
 
-        string commentContent = processedCode.substr(pos + 2, endPos - (pos + 2));
-        
-        string trimmedContent = commentContent;
-        size_t first = trimmedContent.find_first_not_of(" \t\r\n");
-        if (first == string::npos) { 
-            processedCode.replace(pos, (endPos + 2) - pos, "");
-            continue;
-        }
-        trimmedContent.erase(0, first);
-        size_t last = trimmedContent.find_last_not_of(" \t\r\n");
-        if (last != string::npos) trimmedContent.erase(last + 1);
+inline long long fileMtime(const fs::path& p) {
+    std::error_code ec;
+    auto t = fs::last_write_time(p, ec);
+    return ec ? 0 : (long long)t.time_since_epoch().count();
+}
 
-        bool isBlockContainer = (trimmedContent.rfind("$$", 0) == 0 && trimmedContent.rfind("$$") == trimmedContent.length() - 2);
-        bool isInlineContainer = (trimmedContent.rfind("$", 0) == 0 && trimmedContent.rfind("$") == trimmedContent.length() - 1);
+inline string readFileBinary(const fs::path& p) {
+    ifstream f(p, ios::binary);
+    return string((istreambuf_iterator<char>(f)), istreambuf_iterator<char>());
+}
 
-        if (isBlockContainer || isInlineContainer) {
-            processedCode.replace(pos, (endPos + 2) - pos, commentContent);
-            pos += commentContent.length();
-        } else {
-            processedCode.replace(pos, (endPos + 2) - pos, "");
+// Expansion digest of a cached module if it is still valid, "" otherwise
+inline string verifyCachedModule(const string& absPath) {
+    ModuleEntry e;
+    {
+        lock_guard<mutex> lock(MODULE_CACHE_MUTEX);
+        auto v = MODULE_VERIFIED.find(absPath);
+        if (v != MODULE_VERIFIED.end()) return v->second;
+        auto it = MODULE_CACHE.find(absPath);
+        if (it == MODULE_CACHE.end()) return "";
+        e = it->second;
+    }
+
+    bool ok = true;
+    std::error_code ec;
+    uintmax_t size = fs::file_size(absPath, ec);
+    long long mtime = fileMtime(absPath);
+    if (ec || size != e.size) ok = false;
+    else if (mtime != e.mtime) {
+        // Touched but maybe not changed: compare content, and refresh the stamp if equal
+        ok = sha256Hex(readFileBinary(absPath)) == e.digest;
+        if (ok) {
+            lock_guard<mutex> lock(MODULE_CACHE_MUTEX);
+            MODULE_CACHE[absPath].mtime = mtime;
+            MODULE_CACHE_DIRTY = true;
         }
     }
+    if (ok && !fs::exists(getCachePath(e.expansion))) ok = false;
 
-    // --- Handle Glupe line comments: % ... ---
-    pos = 0;
-    while ((pos = processedCode.find("%", pos)) != string::npos) {
-        size_t endOfLine = processedCode.find('\n', pos);
-        if (endOfLine == string::npos) endOfLine = processedCode.length();
+    for (const auto& imp : e.imports) {
+        if (!ok) break;
+        if (imp.canonical.empty()) { ok = !fs::exists(imp.target, ec); continue; }
+        if (!fs::exists(imp.target, ec) || fs::canonical(imp.target, ec).string() != imp.canonical) { ok = false; continue; }
+        ok = verifyCachedModule(imp.canonical) == imp.expansion;
+    }
 
-        string commentContent = processedCode.substr(pos + 1, endOfLine - (pos + 1));
-        
-        string trimmedContent = commentContent;
-        size_t first = trimmedContent.find_first_not_of(" \t\r\n");
-        if (first == string::npos) { 
-            pos = endOfLine;
-            if (pos >= processedCode.length()) break;
-            continue;
-        }
-        trimmedContent.erase(0, first);
-        size_t last = trimmedContent.find_last_not_of(" \t\r\n");
-        if (last != string::npos) trimmedContent.erase(last + 1);
+    lock_guard<mutex> lock(MODULE_CACHE_MUTEX);
+    MODULE_VERIFIED[absPath] = ok ? e.expansion : "";
+    return ok ? e.expansion : "";
+}
 
-        bool isInlineContainer = (trimmedContent.rfind("$", 0) == 0 && trimmedContent.rfind("$") == trimmedContent.length() - 1);
+inline string resolveImportsInto(const string& code, const fs::path& basePath, vector<string>& stack, bool& cacheable, vector<ModuleImport>* importsOut);
 
-        if (isInlineContainer) {
-            processedCode.replace(pos, endOfLine - pos, commentContent);
-            pos += commentContent.length();
-        } else {
-            pos = endOfLine;
-            if (pos >= processedCode.length()) break;
-        }
+// Resolved text of one imported file. `cacheable` turns false if a cycle or I/O error below it
+// made the result depend on who imported it.
+inline string loadModule(const fs::path& path, const string& absPath, vector<string>& stack, bool& cacheable, string& expansionDigest) {
+    string cached = verifyCachedModule(absPath);
+    if (!cached.empty()) {
+        expansionDigest = cached;
+        if (VERBOSE_MODE) log("INFO", "Module cache hit: " + absPath);
+        return getCachedContent(cached);
     }
-    return processedCode;
+
+    ifstream imp(path, ios::binary);
+    if (!imp.is_open()) { cacheable = false; return ""; }
+    string content((istreambuf_iterator<char>(imp)), istreambuf_iterator<char>());
+
+    bool subCacheable = true;
+    vector<ModuleImport> imports;
+    stack.push_back(absPath);
+    string nested = resolveImportsInto(content, path.parent_path(), stack, subCacheable, &imports);
+    stack.pop_back();
+
+    expansionDigest = sha256Hex(nested);
+    if (subCacheable) {
+        setCachedContent(expansionDigest, nested);
+        ModuleEntry e;
+        std::error_code ec;
+        e.size = fs::file_size(path, ec);
+        e.mtime = fileMtime(path);
+        e.digest = sha256Hex(content);
+        e.expansion = expansionDigest;
+        e.imports = move(imports);
+        lock_guard<mutex> lock(MODULE_CACHE_MUTEX);
+        MODULE_CACHE[absPath] = move(e);
+        MODULE_VERIFIED[absPath] = expansionDigest;
+        MODULE_CACHE_DIRTY = true;
+    } else {
+        cacheable = false;
+    }
+    return nested;
 }
 
-inline string resolveImports(string code, fs::path basePath, vector<string>& stack) {
-    stringstream ss(code);
-    string line;
-    vector<string> lines;
-    while (getline(ss, line)) lines.push_back(line);
+inline string resolveImportsInto(const string& code, const fs::path& basePath, vector<string>& stack, bool& cacheable, vector<ModuleImport>* importsOut) {
+    // Split once into line spans (getline semantics: a trailing newline does not start a new line)
+    vector<pair<size_t, size_t>> lines;
+    for (size_t start = 0; start < code.size();) {
+        size_t nl = code.find('\n', start);
+        size_t end = (nl == string::npos) ? code.size() : nl;
+        lines.push_back({start, end});
+        start = end + 1;
+    }
+    auto lineAt = [&](size_t i) { return string_view(code).substr(lines[i].first, lines[i].second - lines[i].first); };
+    auto trimmedAt = [&](size_t i) {
+        string_view l = lineAt(i);
+        size_t nf = l.find_first_not_of(" \t\r\n");
+        return nf == string_view::npos ? string_view() : l.substr(nf);
+    };
+
+    // Literal text and imports alternate; imports are filled in afterwards, siblings in parallel
+    struct ImportJob {
+        string fname;
+        string localModifications;
+        size_t part;
+        string text;
+        ModuleImport record;
+        bool cacheable = true;
+    };
+    vector<string> parts(1);
+    vector<ImportJob> jobs;
 
-    string processed;
-    
     for (size_t i = 0; i < lines.size(); ++i) {
-        string cleanLine = lines[i];
-        size_t first = cleanLine.find_first_not_of(" \t\r\n");
-        if (first == string::npos) { processed += lines[i] + "\n"; continue; }
-        cleanLine.erase(0, first);
-        
+        string_view cleanLine = trimmedAt(i);
+        if (cleanLine.empty()) { parts.back().append(lineAt(i)).append("\n"); continue; }
+
         // Ignore orphaned IMPORT: END lines (they should be consumed by blocks)
         if (cleanLine == "IMPORT: END") continue;
 
         if (cleanLine.rfind("IMPORT:", 0) == 0) {
-            string directiveContent = cleanLine.substr(7);
+            string directiveContent(cleanLine.substr(7));
             string fname;
             
             // Robust filename extraction
@@ -165,15 +298,11 @@ inline string resolveImports(string code, fs::path basePath, vector<string>& sta
             }
 
             // Look ahead for block content
-            string localModifications;
+            ImportJob job;
+            job.fname = fname;
             int blockEndIndex = -1;
-            
             for (size_t j = i + 1; j < lines.size(); ++j) {
-                string nextClean = lines[j];
-                size_t nf = nextClean.find_first_not_of(" \t\r\n");
-                if (nf != string::npos) nextClean.erase(0, nf);
-                else nextClean = "";
-
+                string_view nextClean = trimmedAt(j);
                 if (nextClean == "IMPORT: END") {
                     blockEndIndex = j;
                     break;
@@ -184,47 +313,87 @@ inline string resolveImports(string code, fs::path basePath, vector<string>& sta
             }
 
             if (blockEndIndex != -1) {
-                for (size_t k = i + 1; k < blockEndIndex; ++k) {
-                    localModifications += lines[k] + "\n";
+                for (size_t k = i + 1; k < (size_t)blockEndIndex; ++k) {
+                    job.localModifications.append(lineAt(k)).append("\n");
                 }
                 i = blockEndIndex; // Skip consumed lines
             }
 
-            fs::path path = basePath / fname;
-            try {
-                if (fs::exists(path)) {
-                    string absPath = fs::canonical(path).string();
-                    bool cycle = false;
-                    for(const auto& s : stack) if(s == absPath) cycle = true;
-                    if (cycle) {
-                        processed += "// [ERROR] CYCLIC IMPORT DETECTED: " + fname + "\n";
-                        log("ERROR", "Circular import: " + fname);
-                    } else {
-                        ifstream imp(path);
-                        if (imp.is_open()) {
-                            string content((istreambuf_iterator<char>(imp)), istreambuf_iterator<char>());
-                            stack.push_back(absPath);
-                            string nested = resolveImports(content, path.parent_path(), stack);
-                            stack.pop_back();
-                            
-                            processed += "\n// --- IMPORTED FILE: " + fname + " ---\n";
-                            processed += nested;
-                            if (!localModifications.empty()) {
-                                processed += "// --- LOCAL MODIFICATIONS ---\n";
-                                processed += localModifications;
-                            }
-                            processed += "// --- END IMPORT ---\n";
-                            log("INFO", "Imported module: " + fname);
-                        }
-                    }
-                } else {
-                    processed += "// [WARN] IMPORT NOT FOUND: " + fname + "\n";
-                }
-            } catch (...) { processed += "// [ERROR] PATH EXCEPTION\n"; }
+            job.part = parts.size();
+            parts.emplace_back();
+            parts.emplace_back();
+            jobs.push_back(move(job));
         } else {
-            processed += lines[i] + "\n";
+            parts.back().append(lineAt(i)).append("\n");
         }
     }
+
+    auto runJob = [&](size_t j) {
+        ImportJob& job = jobs[j];
+        const string& fname = job.fname;
+        string& processed = job.text;
+        fs::path path = basePath / fname;
+        job.record.target = path.string();
+        try {
+            if (fs::exists(path)) {
+                string absPath = fs::canonical(path).string();
+                job.record.canonical = absPath;
+                bool cycle = false;
+                for(const auto& s : stack) if(s == absPath) cycle = true;
+                if (cycle) {
+                    processed += "// [ERROR] CYCLIC IMPORT DETECTED: " + fname + "\n";
+                    log("ERROR", "Circular import: " + fname);
+                    job.cacheable = false;
+                } else {
+                    vector<string> localStack = stack; // Siblings may run concurrently
+                    string nested = loadModule(path, absPath, localStack, job.cacheable, job.record.expansion);
+                    
+                    processed += "\n// --- IMPORTED FILE: " + fname + " ---\n";
+                    processed += nested;
+                    if (!job.localModifications.empty()) {
+                        processed += "// --- LOCAL MODIFICATIONS ---\n";
+                        processed += job.localModifications;
+                    }
+                    processed += "// --- END IMPORT ---\n";
+                    log("INFO", "Imported module: " + fname);
+                }
+            } else {
+                processed += "// [WARN] IMPORT NOT FOUND: " + fname + "\n";
+            }
+        } catch (...) { processed += "// [ERROR] PATH EXCEPTION\n"; job.cacheable = false; }
+    };
+
+    // Borrow extra threads from a process-wide budget so nested levels cannot multiply them
+    int extra = 0;
+    if (jobs.size() > 1) {
+        int cap = (int)max(2u, thread::hardware_concurrency()) - 1;
+        int want = (int)jobs.size() - 1;
+        int cur = IMPORT_WORKERS.load();
+        while (cur < cap && !IMPORT_WORKERS.compare_exchange_weak(cur, cur + min(want, cap - cur))) {}
+        if (cur < cap) extra = min(want, cap - cur);
+    }
+    parallelFor(jobs.size(), 1 + extra, runJob);
+    IMPORT_WORKERS -= extra;
+
+    size_t total = 0;
+    for (auto& job : jobs) {
+        parts[job.part] = move(job.text);
+        if (!job.cacheable) cacheable = false;
+        if (importsOut) importsOut->push_back(job.record);
+    }
+    for (const auto& p : parts) total += p.size();
+    string processed;
+    processed.reserve(total);
+    for (const auto& p : parts) processed += p;
+    return processed;
+}
+
+inline string resolveImports(string code, fs::path basePath, vector<string>& stack) {
+    bool cacheable = true;
+    if (code.find("IMPORT:") == string::npos) return resolveImportsInto(code, basePath, stack, cacheable, nullptr);
+    loadModuleCache();
+    string processed = resolveImportsInto(code, basePath, stack, cacheable, nullptr);
+    if (stack.empty()) saveModuleCache();
     return processed;
 }
 
@@ -243,294 +412,50 @@ inline string stripTemplates(const string& line, bool& insideTemplate) {
         }
     }
 
-    while (pos < line.length()) {
-        size_t start = line.find("$", pos);
-        if (start == string::npos) {
-            result += line.substr(pos);
-            break;
-        }
-        
-        bool isBlock = false;
-        bool isInline = false;
-        size_t scan = 0;
-
-        if (start + 1 < line.length() && line[start+1] == '$') {
-            isBlock = true;
-            scan = start + 2;
-        } else {
-            // Inline check
-            size_t openB = line.find('{', start);
-            if (openB != string::npos) {
-                size_t searchPos = openB + 1;
-                while (searchPos < line.length()) {
-                    size_t closeB = line.find('}', searchPos);
-                    if (closeB == string::npos) break;
-                    size_t check = closeB + 1;
-                    while (check < line.length() && isspace(line[check])) check++;
-                    if (check < line.length() && line[check] == '$') {
-                        isInline = true;
-                        scan = start + 1;
-                        break;
-                    }
-                    searchPos = closeB + 1;
-                }
-            }
-        }
-
-        if (!isBlock && !isInline) {
-            result += line.substr(pos, start - pos + 1);
-            pos = start + 1;
-            continue;
-        }
-
-        bool isContainer = false;
-        size_t contentStart = 0;
-
-        // Check anonymous $${
-        if (start + 2 < line.length() && line[start+2] == '{') {
-            isContainer = true;
-            contentStart = start + 3;
-        } 
-        // Check named $$ "id" {
-        else {
-            while(scan < line.length() && isspace(line[scan])) scan++;
-            
-            // [NEW] Skip ABSTRACT keyword in stripper
-            if (scan + 8 <= line.length() && line.compare(scan, 8, "ABSTRACT") == 0 && (scan + 8 == line.length() || isspace(line[scan+8]))) {
-                scan += 8;
-                while(scan < line.length() && isspace(line[scan])) scan++;
-            }
-
-            if (scan < line.length() && line[scan] != '{') {
-                while(scan < line.length() && !isspace(line[scan]) && line[scan] != '{' && !(line[scan] == '-' && scan+1 < line.length() && line[scan+1] == '>')) {
-                    scan++;
-                }
-                
-                size_t brace = scan;
-                while(brace < line.length() && isspace(line[brace])) brace++;
-                
-                // [NEW] Skip inheritance syntax in stripper
-                if (brace + 1 < line.length() && line[brace] == '-' && line[brace+1] == '>') {
-                     size_t pScan = brace + 2;
-                     while(pScan < line.length() && line[pScan] != '{') pScan++; // Skip until {
-                     brace = pScan;
-                }
-
-                while(brace < line.length() && isspace(line[brace])) brace++;
-                if (brace < line.length() && line[brace] == '{') {
-                    isContainer = true;
-                    contentStart = brace + 1;
-                }
-            }
-        }
-
-        if (isContainer) {
-            if (start > pos) {
-                result += line.substr(pos, start - pos);
-            }
-            size_t end = string::npos;
-            size_t nextPos = 0;
-            if (isBlock) {
-                end = line.find("}$$", contentStart);
-                if (end != string::npos) nextPos = end + 3;
-            } else {
-                size_t searchPos = contentStart;
-                while (searchPos < line.length()) {
-                    size_t closeB = line.find('}', searchPos);
-                    if (closeB == string::npos) break;
-                    size_t check = closeB + 1;
-                    while (check < line.length() && isspace(line[check])) check++;
-                    if (check < line.length() && line[check] == '$') {
-                        end = closeB;
-                        nextPos = check + 1;
-                        break;
-                    }
-                    searchPos = closeB + 1;
-                }
-            }
+    for (const GlupeToken& tok : lexGlupe(line)) {
+        if (tok.start < pos) continue; // Nested in a template already stripped
+        if (tok.kind != GlupeTokenKind::CONTAINER && tok.kind != GlupeTokenKind::ANONYMOUS) continue;
 
-            if (end == string::npos) {
-                insideTemplate = true;
-                break;
-            }
-            pos = nextPos;
-        } else {
-            // Not a container, keep $$
-            result += line.substr(pos, start - pos + (isBlock ? 2 : 1));
-            pos = start + (isBlock ? 2 : 1);
+        result.append(line, pos, tok.start - pos);
+        if (!tok.closed) {
+            insideTemplate = true; // Closer is on a later line
+            return result;
         }
+        pos = tok.end;
     }
+    result.append(line, pos, string::npos);
     return result;
 }
 
 // [NEW] Validate container names and detect collisions
-inline bool validateContainers(const string& code, bool* outHasActive = nullptr) {
-    set<string> ids;
-    size_t pos = 0;
-    while ((pos = code.find("$", pos)) != string::npos) {
-        bool isBlock = false;
-        bool isInline = false;
-        size_t scan = 0;
-
-        if (pos + 1 < code.length() && code[pos+1] == '$') {
-            isBlock = true;
-            scan = pos + 2;
-        } else {
-            size_t lineEnd = code.find('\n', pos);
-            if (lineEnd == string::npos) lineEnd = code.length();
-            size_t openB = code.find('{', pos);
-            if (openB != string::npos && openB < lineEnd) {
-                size_t searchPos = openB + 1;
-                while (searchPos < lineEnd) {
-                    size_t closeB = code.find('}', searchPos);
-                    if (closeB == string::npos || closeB >= lineEnd) break;
-                    size_t check = closeB + 1;
-                    while (check < lineEnd && isspace(code[check])) check++;
-                    if (check < lineEnd && code[check] == '$') {
-                        isInline = true;
-                        scan = pos + 1;
-                        break;
-                    }
-                    searchPos = closeB + 1;
-                }
-            }
-        }
-
-        if (!isBlock && !isInline) { 
-            // [NEW] Check for malformed inline container (multiline)
-            size_t lineEnd = code.find('\n', pos);
-            if (lineEnd == string::npos) lineEnd = code.length();
-            
-            size_t check = pos + 1;
-            while(check < lineEnd && isspace(code[check])) check++;
-            
-            bool isHeader = false;
-            size_t bracePos = string::npos;
-
-            // Case: $ {
-            if (check < lineEnd && code[check] == '{') {
-                isHeader = true;
-                bracePos = check;
-            } 
-            // Case: $ ID ... or $ -> ...
-            else {
-                size_t idStart = check;
-                while(check < lineEnd && (isalnum(static_cast<unsigned char>(code[check])) || code[check] == '_')) check++;
-                
-                // If we advanced (found ID) or didn't (maybe just ->), check next
-                while(check < lineEnd && isspace(code[check])) check++;
-                
-                // [FIX] Handle parameters (...)
-                if (check < lineEnd && code[check] == '(') {
-                    size_t closeP = code.find(')', check);
-                    if (closeP != string::npos && closeP < lineEnd) {
-                        check = closeP + 1;
-                        while(check < lineEnd && isspace(code[check])) check++;
-                    }
-                }
-
-                if (check < lineEnd && code[check] == '{') {
-                    isHeader = true; // $ ID {
-                    bracePos = check;
-                } else if (check + 1 < lineEnd && code[check] == '-' && code[check+1] == '>') {
-                    // $ ... -> ...
-                    check += 2;
-                    while(check < lineEnd && code[check] != '{') check++; // Skip parents
-                    if (check < lineEnd && code[check] == '{') {
-                        isHeader = true;
-                        bracePos = check;
-                    }
-                }
-            }
+// `tokens` is the lexGlupe() stream for `code` when the caller already has it.
+inline bool validateContainers(const string& code, bool* outHasActive = nullptr, const vector<GlupeToken>* tokens = nullptr) {
+    vector<GlupeToken> lexed;
+    if (!tokens) { lexed = lexGlupe(code); tokens = &lexed; }
 
-            if (isHeader) {
-                // If it looks like a container start but !isInline, check if it lacks closing brace on same line
-                size_t closeB = code.find('}', bracePos);
-                bool hasClosingBrace = (closeB != string::npos && closeB < lineEnd);
-                
-                if (!hasClosingBrace) {
-                     int lineNum = 1;
-                     for(size_t i=0; i<pos; ++i) if(code[i] == '\n') lineNum++;
-                     cerr << "[ERROR] Malformed inline container at line " << lineNum << ".\n        Inline containers ($ ... $) must be closed on the same line.\n        Use block containers ($$ ... $$) for multi-line logic.\n        Context: " << code.substr(pos, min((size_t)50, lineEnd - pos)) << "..." << endl;
-                     return false;
-                }
-            }
-            pos++; continue; 
+    set<string> ids;
+    for (const GlupeToken& tok : *tokens) {
+        if (tok.kind == GlupeTokenKind::MALFORMED_INLINE) {
+            cerr << "[ERROR] Malformed inline container at line " << tok.line << ".\n        Inline containers ($ ... $) must be closed on the same line.\n        Use block containers ($$ ... $$) for multi-line logic.\n        Context: " << code.substr(tok.start, min((size_t)50, tok.contentEnd - tok.start)) << "..." << endl;
+            return false;
         }
-
-        // Check anonymous $${ (skip)
-        if (scan < code.length() && code[scan] == '{') {
+        if (tok.kind == GlupeTokenKind::ANONYMOUS) {
             if (outHasActive) *outHasActive = true;
-            pos = scan + 1; continue;
-        }
-        // Check named $$ "id" {
-        while(scan < code.length() && isspace(code[scan])) scan++;
-        
-        // [NEW] Skip ABSTRACT keyword in validator
-        bool isAbstract = false;
-        if (scan + 8 <= code.length() && code.compare(scan, 8, "ABSTRACT") == 0 && (scan + 8 == code.length() || isspace(code[scan+8]))) {
-            isAbstract = true;
-            scan += 8;
-            while(scan < code.length() && isspace(code[scan])) scan++;
+            continue;
         }
+        if (tok.kind != GlupeTokenKind::CONTAINER) continue;
 
-        if (scan < code.length() && code[scan] != '{') {
-            size_t idStart = scan;
-            while(scan < code.length() && !isspace(code[scan]) && code[scan] != '{' && !(code[scan] == '-' && scan+1 < code.length() && code[scan+1] == '>')) {
-                scan++;
-            }
-            
-            if (scan > idStart) {
-                string id = code.substr(idStart, scan - idStart);
-                size_t brace = scan;
-                
-                // [NEW] Skip inheritance syntax in validator
-                while(brace < code.length() && isspace(code[brace])) brace++;
-                if (brace + 1 < code.length() && code[brace] == '-' && code[brace+1] == '>') {
-                     size_t pScan = brace + 2;
-                     while(pScan < code.length() && code[pScan] != '{') pScan++; // Skip until {
-                     brace = pScan;
-                }
-
-                while(brace < code.length() && isspace(code[brace])) brace++;
-                if (brace < code.length() && code[brace] == '{') {
-                    if (ids.count(id)) {
-                        cerr << "[ERROR] Duplicate container ID found: \"" << id << "\"" << endl;
-                        return false;
-                    }
-                    ids.insert(id);
-                    if (outHasActive && !isAbstract) *outHasActive = true;
-                    
-                    // [FIX] Check for closing tag and skip content to avoid false positives inside prompts
-                    size_t end = string::npos;
-                    size_t nextPos = 0;
-                    if (isBlock) {
-                        end = code.find("}$$", brace + 1);
-                        if (end != string::npos) nextPos = end + 3;
-                    } else {
-                        size_t searchPos = brace + 1;
-                        while (searchPos < code.length()) {
-                            size_t closeB = code.find('}', searchPos);
-                            if (closeB == string::npos) break;
-                            size_t check = closeB + 1;
-                            while (check < code.length() && isspace(code[check])) check++;
-                            if (check < code.length() && code[check] == '$') {
-                                end = closeB; nextPos = check + 1; break;
-                            }
-                            searchPos = closeB + 1;
-                        }
-                    }
+        if (ids.count(tok.id)) {
+            cerr << "[ERROR] Duplicate container ID found: \"" << tok.id << "\"" << endl;
+            return false;
+        }
+        ids.insert(tok.id);
+        if (outHasActive && !tok.isAbstract) *outHasActive = true;
 
-                    if (end == string::npos) {
-                        cerr << "[ERROR] Unclosed container: \"" << id << "\"" << endl;
-                        return false;
-                    }
-                    pos = nextPos;
-                    continue;
-                }
-            }
+        if (!tok.closed) {
+            cerr << "[ERROR] Unclosed container: \"" << tok.id << "\"" << endl;
+            return false;
         }
-        pos = scan;
     }
     return true;
 }
@@ -663,7 +588,8 @@ inline bool preFlightCheck(const set<string>& deps) {
     if (CURRENT_LANG.checkCmd.empty() && CURRENT_LANG.id != "cpp" && CURRENT_LANG.id != "c") return true; 
 
     cout << "[CHECK] Verifying dependencies locally..." << endl;
-    string tempCheck = "temp_dep_check" + CURRENT_LANG.extension;
+    // Next to the sources, so local headers and modules resolve; the name is unique to this run
+    string tempCheck = "temp_dep_check_" + scratchId() + CURRENT_LANG.extension;
     ofstream out(tempCheck);
     
     if (CURRENT_LANG.id == "cpp" || CURRENT_LANG.id == "c") {
@@ -682,6 +608,8 @@ inline bool preFlightCheck(const set<string>& deps) {
     string cmd;
     if (!CURRENT_LANG.checkCmd.empty()) {
         cmd = CURRENT_LANG.checkCmd + " \"" + tempCheck + "\"";
+    } else if (!CURRENT_LANG.syntaxCmd.empty()) {
+        cmd = CURRENT_LANG.syntaxCmd + " \"" + tempCheck + "\""; // Only whether the headers resolve matters
     } else {
         cmd = CURRENT_LANG.buildCmd + " -c \"" + tempCheck + "\""; 
     }
@@ -779,6 +707,376 @@ inline string extractSignatures(const string& code) {
     return result;
 }
 
+// --- PARALLEL REFINE ---
+// Chunks refined concurrently cannot see each other's output, so each one gets its context from
+// the source instead: the signature outline of the file and a few lines on either side of it.
+
+// `sigs` holds extractSignatures() of each chunk. All of them when they fit in `budget` bytes
+// (0: no limit): the same text for every chunk, so it is part of the prefix the server caches.
+// Larger files keep the signatures of the chunks nearest to chunk `i`, printed in file order.
+inline string refineOutline(const vector<string>& sigs, size_t i, size_t budget) {
+    size_t total = 0;
+    for (const auto& s : sigs) total += s.size();
+    if (budget == 0 || total <= budget) {
+        string all;
+        for (const auto& s : sigs) all += s;
+        return all;
+    }
+    vector<bool> take(sigs.size(), false);
+    size_t used = 0;
+    for (size_t d = 0; d < sigs.size(); d++) {
+        for (size_t j : {i - d, i + d}) { // i - d wraps past 0 and fails the bound check
+            if (j >= sigs.size() || take[j] || used + sigs[j].size() > budget) continue;
+            take[j] = true;
+            used += sigs[j].size();
+        }
+    }
+    string out;
+    for (size_t j = 0; j < sigs.size(); j++) if (take[j]) out += sigs[j];
+    return out;
+}
+
+// The last `lines` lines of the previous chunk and the first `lines` of the next one
+inline string refineOverlap(const vector<string>& chunks, size_t i, int lines) {
+    auto split = [](const string& s) {
+        vector<string> v;
+        stringstream ss(s);
+        string l;
+        while (getline(ss, l)) v.push_back(l);
+        return v;
+    };
+    string out;
+    if (i > 0) {
+        vector<string> prev = split(chunks[i - 1]);
+        out += "--- END OF THE PREVIOUS PART ---\n";
+        for (size_t k = prev.size() > (size_t)lines ? prev.size() - lines : 0; k < prev.size(); k++) out += prev[k] + "\n";
+    }
+    if (i + 1 < chunks.size()) {
+        vector<string> next = split(chunks[i + 1]);
+        out += "--- START OF THE NEXT PART ---\n";
+        for (size_t k = 0; k < next.size() && k < (size_t)lines; k++) out += next[k] + "\n";
+    }
+    return out;
+}
+
+// Joins refined chunks in order. A block emitted by several chunks (a function cut by a chunk
+// boundary, a global both neighbours saw) is kept once, where it first appears, with the most
+// detailed of its versions.
+inline string stitchRefinedChunks(const vector<string>& parts) {
+    struct Occurrence { size_t part, start, end; };
+    map<string, vector<Occurrence>> byId;
+    vector<string> order;
+    for (size_t p = 0; p < parts.size(); p++) {
+        for (const auto& t : lexGlupe(parts[p])) {
+            if (t.kind != GlupeTokenKind::CONTAINER || !t.isBlock || !t.closed || t.id.empty()) continue;
+            if (byId[t.id].empty()) order.push_back(t.id);
+            byId[t.id].push_back({p, t.start, t.end});
+        }
+    }
+
+    // Per part: (start, end, replacement) edits
+    vector<vector<tuple<size_t, size_t, string>>> edits(parts.size());
+    int merged = 0;
+    for (const auto& id : order) {
+        const auto& occ = byId[id];
+        if (occ.size() < 2) continue;
+        size_t best = 0;
+        for (size_t k = 1; k < occ.size(); k++) {
+            if (occ[k].end - occ[k].start > occ[best].end - occ[best].start) best = k;
+        }
+        string winner = parts[occ[best].part].substr(occ[best].start, occ[best].end - occ[best].start);
+        edits[occ[0].part].push_back({occ[0].start, occ[0].end, winner});
+        for (size_t k = 1; k < occ.size(); k++) {
+            size_t end = occ[k].end;
+            if (end < parts[occ[k].part].size() && parts[occ[k].part][end] == '\n') end++;
+            edits[occ[k].part].push_back({occ[k].start, end, ""});
+        }
+        merged += (int)occ.size() - 1;
+    }
+    if (merged > 0) cout << "   [REFINE] Merged " << merged << " duplicate block(s) from overlapping chunks." << endl;
+
+    string out;
+    for (size_t p = 0; p < parts.size(); p++) {
+        auto& e = edits[p];
+        sort(e.begin(), e.end());
+        size_t pos = 0;
+        for (const auto& [s, en, text] : e) {
+            if (s < pos) continue; // Nested in an edit already made
+            out += parts[p].substr(pos, s - pos) + text;
+            pos = en;
+        }
+        out += parts[p].substr(pos) + "\n";
+    }
+    return out;
+}
+
+// [NEW] Context pruning for -fill
+// A container used to receive the whole file as context, so prompts grew with the file and total
+// tokens with (containers x file size). When the file exceeds the budget, each container gets:
+//   1. an outline: extractSignatures() over declaration-level lines (top level and type bodies),
+//      capped at a quarter of the budget and identical for every container (a shared prompt prefix),
+//   2. full definitions of top-level symbols its prompt mentions,
+//   3. its enclosing scope (with the headers of outer scopes), clipped around the container.
+// The scope gets half of what the outline leaves, and the definitions get whatever remains after that.
+// Indentation languages (CURRENT_LANG) are scoped by indentation; the rest by braces (strings and
+// comments skipped). `skip` spans (prompts of containers still to generate) are not scanned.
+struct FillContextBuilder {
+    struct Block {
+        size_t start = 0; // Start of the header line
+        size_t end = 0;   // Past the line that closes it
+        string name;      // Defined symbol ("" for control blocks)
+        bool isType = false; // class/struct/namespace...: its members are declarations
+    };
+
+    FillContextBuilder(const string& file, size_t budgetBytes, vector<pair<size_t, size_t>> skip = {})
+        : file(file), budget(budgetBytes), skip(std::move(skip)) {
+        sort(this->skip.begin(), this->skip.end());
+        for (size_t p = 0; p <= file.size(); ) {
+            lineStarts.push_back(p);
+            size_t nl = file.find('\n', p);
+            if (nl == string::npos) break;
+            p = nl + 1;
+        }
+        lineDepth.assign(lineStarts.size(), 0);
+        skippedLine.assign(lineStarts.size(), false);
+        for (const auto& [s, e] : this->skip) {
+            for (size_t l = lineOf(s); l < lineStarts.size() && lineStarts[l] < e; l++) skippedLine[l] = true;
+        }
+        if (usesIndentation(CURRENT_LANG.id)) scanIndentation();
+        else scanBraces();
+
+        vector<bool> member(lineStarts.size(), false);
+        for (const auto& b : blocks) {
+            if (!b.isType) continue;
+            for (size_t l = lineOf(b.start) + 1; l < lineStarts.size() && lineStarts[l] < b.end; l++) member[l] = true;
+        }
+        size_t left = budget / 4, omitted = 0;
+        for (size_t l = 0; l < lineStarts.size(); l++) {
+            if (skippedLine[l]) continue;
+            if (lineDepth[l] == 0 || (lineDepth[l] == 1 && member[l])) {
+                string sig = extractSignatures(lineText(l) + "\n");
+                if (sig.empty()) continue;
+                if (sig.size() > left) { omitted++; continue; }
+                outline += sig;
+                left -= sig.size();
+            }
+        }
+        if (omitted) outline += "// ... " + to_string(omitted) + " more declaration(s) omitted\n";
+    }
+
+    // Context for the container whose text is file[pos, pos + len)
+    string forContainer(size_t pos, size_t len, const string& prompt) const {
+        if (budget == 0 || file.size() <= budget || pos >= file.size()) return file;
+
+        // 3. Enclosing scope: innermost block around the container, clipped to half the budget
+        const Block* scope = nullptr;
+        vector<const Block*> outer;
+        for (const auto& b : blocks) {
+            if (b.start <= pos && pos + len <= b.end) {
+                if (scope) outer.push_back(scope);
+                scope = &b;
+            }
+        }
+        size_t first = lineOf(pos), last = lineOf(pos + len > 0 ? pos + len - 1 : pos);
+        size_t lo = scope ? lineOf(scope->start) : 0;
+        size_t hi = scope ? lineOf(scope->end > 0 ? scope->end - 1 : 0) : lineStarts.size() - 1;
+        size_t rest = budget > outline.size() ? budget - outline.size() : 0;
+        size_t room = rest / 2;
+        size_t used = bytesOf(first, last);
+        while (used < room && (first > lo || last < hi)) {
+            if (first > lo) { used += bytesOf(first - 1, first - 1); first--; }
+            if (last < hi && used < room) { used += bytesOf(last + 1, last + 1); last++; }
+        }
+        string scopeText;
+        for (const Block* b : outer) scopeText += lineText(lineOf(b->start)) + "\n    ...\n";
+        if (scope && first > lo) scopeText += lineText(lo) + "\n    ...\n";
+        scopeText += file.substr(lineStarts[first], lineEnd(last) - lineStarts[first]) + "\n";
+        if (scope && last < hi) scopeText += "    ...\n" + lineText(hi) + "\n";
+        size_t shownFrom = lineStarts[first], shownTo = lineEnd(last);
+
+        // 2. Definitions the container refers to, outside what is already shown
+        set<string> words;
+        for (size_t i = 0; i < prompt.size(); ) {
+            if (isalpha(static_cast<unsigned char>(prompt[i])) || prompt[i] == '_') {
+                size_t j = i;
+                while (j < prompt.size() && (isalnum(static_cast<unsigned char>(prompt[j])) || prompt[j] == '_')) j++;
+                words.insert(prompt.substr(i, j - i));
+                i = j;
+            } else i++;
+        }
+        string defsText;
+        size_t left = rest > scopeText.size() ? rest - scopeText.size() : 0;
+        for (const auto& b : blocks) {
+            if (b.name.empty() || !words.count(b.name)) continue;
+            if (b.start < shownTo && shownFrom < b.end) continue;
+            if (b.end - b.start > left) continue; // Its signature is in the outline
+            defsText += file.substr(b.start, b.end - b.start);
+            if (defsText.back() != '\n') defsText += "\n";
+            left -= b.end - b.start;
+        }
+
+        stringstream out;
+        out << "// [CONTEXT PRUNED: " << file.size() << " byte file reduced to the parts this container depends on]\n";
+        out << "// --- FILE OUTLINE ---\n" << outline;
+        if (!defsText.empty()) out << "// --- REFERENCED DEFINITIONS ---\n" << defsText;
+        out << "// --- ENCLOSING SCOPE ---\n" << scopeText;
+        return out.str();
+    }
+
+private:
+    const string& file;
+    size_t budget;
+    vector<size_t> lineStarts;
+    vector<pair<size_t, size_t>> skip; // [start, end) byte ranges left out of the scan
+    vector<int> lineDepth; // Nesting depth at the start of each line
+    vector<bool> skippedLine; // Line overlaps a skip range
+    vector<Block> blocks;  // Sorted by start; outer blocks come before the blocks they contain
+    string outline; // Same for every container
+
+    size_t lineOf(size_t pos) const {
+        return upper_bound(lineStarts.begin(), lineStarts.end(), pos) - lineStarts.begin() - 1;
+    }
+    size_t lineEnd(size_t l) const {
+        return l + 1 < lineStarts.size() ? lineStarts[l + 1] - 1 : file.size();
+    }
+    string lineText(size_t l) const { return file.substr(lineStarts[l], lineEnd(l) - lineStarts[l]); }
+    size_t bytesOf(size_t a, size_t b) const { return lineEnd(b) - lineStarts[a] + 1; }
+
+    static bool usesIndentation(const string& langId) {
+        return langId == "py" || langId == "nim";
+    }
+
+    static bool identChar(char c) { return isalnum(static_cast<unsigned char>(c)) || c == '_'; }
+
+    static const vector<string>& typeKeywords() {
+        static const vector<string> k = {"class ", "struct ", "enum ", "union ", "namespace ", "interface ", "impl "};
+        return k;
+    }
+
+    static bool isTypeHeader(const string& header) {
+        for (const auto& k : typeKeywords()) {
+            size_t p = header.find(k);
+            if (p != string::npos && (p == 0 || !identChar(header[p-1])) && header.find('(') == string::npos) return true;
+        }
+        return false;
+    }
+
+    // Symbol a block header defines: the name after class/struct/enum/union/namespace/def, or
+    // the identifier before '(' of a function. Control statements define nothing.
+    static string definedName(const string& header) {
+        vector<string> keywords = typeKeywords();
+        keywords.insert(keywords.end(), {"def ", "fn ", "func "});
+        for (const auto& k : keywords) {
+            size_t p = header.find(k);
+            if (p == string::npos || (p > 0 && identChar(header[p-1]))) continue;
+            p += k.size();
+            while (p < header.size() && (header[p] == ' ' || header[p] == '(' )) p++;
+            size_t e = p;
+            while (e < header.size() && identChar(header[e])) e++;
+            if (e > p) return header.substr(p, e - p);
+        }
+        size_t paren = header.find('(');
+        if (paren == string::npos) return "";
+        size_t e = paren;
+        while (e > 0 && header[e-1] == ' ') e--;
+        size_t s = e;
+        while (s > 0 && identChar(header[s-1])) s--;
+        string name = header.substr(s, e - s);
+        static const set<string> control = {"if", "for", "while", "switch", "catch", "return", "sizeof", "else"};
+        return control.count(name) ? "" : name;
+    }
+
+    void scanBraces() {
+        const size_t n = file.size();
+        vector<size_t> stack;
+        size_t line = 0;
+        int depth = 0;
+        size_t nextSkip = 0;
+        for (size_t i = 0; i < n; i++) {
+            while (nextSkip < skip.size() && skip[nextSkip].second <= i) nextSkip++;
+            if (nextSkip < skip.size() && skip[nextSkip].first <= i) {
+                size_t stop = min(skip[nextSkip].second, n);
+                for (size_t k = i; k < stop; k++) if (file[k] == '\n' && ++line < lineDepth.size()) lineDepth[line] = depth;
+                i = stop - 1;
+                continue;
+            }
+            char c = file[i];
+            if (c == '\n') {
+                if (++line < lineDepth.size()) lineDepth[line] = depth;
+            } else if (c == '/' && i + 1 < n && file[i+1] == '/') {
+                while (i + 1 < n && file[i+1] != '\n') i++;
+            } else if (c == '/' && i + 1 < n && file[i+1] == '*') {
+                size_t e = file.find("*/", i + 2);
+                size_t stop = (e == string::npos) ? n : e + 2;
+                for (size_t k = i; k < stop; k++) if (file[k] == '\n' && ++line < lineDepth.size()) lineDepth[line] = depth;
+                i = stop - 1;
+            } else if (c == '"' || c == '\'') {
+                size_t k = i + 1;
+                while (k < n && file[k] != c && file[k] != '\n') k += (file[k] == '\\') ? 2 : 1;
+                i = min(k, n - 1);
+                if (file[i] == '\n') i--; // Unterminated: let the newline be counted
+            } else if (c == '{') {
+                stack.push_back(i);
+                depth++;
+            } else if (c == '}' && !stack.empty()) {
+                size_t open = stack.back();
+                stack.pop_back();
+                depth--;
+                size_t openLine = lineOf(open);
+                // K&R: a lone '{' belongs to the header on the line above
+                string opener = lineText(openLine);
+                if (opener.find_first_not_of(" \t\r") == opener.find('{') && openLine > 0) openLine--;
+                Block b;
+                b.start = lineStarts[openLine];
+                size_t nl = file.find('\n', i);
+                b.end = (nl == string::npos) ? n : nl + 1;
+                string header = file.substr(b.start, open - b.start);
+                if (depthAt(openLine) <= 1) b.name = definedName(header);
+                b.isType = depthAt(openLine) == 0 && isTypeHeader(header);
+                blocks.push_back(b);
+            }
+        }
+        sort(blocks.begin(), blocks.end(), [](const Block& a, const Block& b) { return a.start != b.start ? a.start < b.start : a.end > b.end; });
+    }
+
+    int depthAt(size_t line) const { return line < lineDepth.size() ? lineDepth[line] : 0; }
+
+    // Python and friends: a block is a `def`/`class` line and everything indented below it.
+    // Container markers and prompts sit at column 0 wherever they are, so they do not end a block.
+    void scanIndentation() {
+        vector<bool> inMarker(lineStarts.size(), false);
+        bool open = false;
+        for (size_t l = 0; l < lineStarts.size(); l++) {
+            string t = lineText(l);
+            t.erase(0, t.find_first_not_of(" \t"));
+            if (t.rfind("// GLUPE_BLOCK_START: ", 0) == 0) open = true;
+            inMarker[l] = open || skippedLine[l];
+            if (t.rfind("// GLUPE_BLOCK_END: ", 0) == 0) open = false;
+        }
+        auto indentOf = [&](size_t l) -> int {
+            if (inMarker[l]) return -1;
+            string t = lineText(l);
+            size_t p = t.find_first_not_of(" \t");
+            return (p == string::npos || t[p] == '#') ? -1 : (int)p;
+        };
+        for (size_t l = 0; l < lineStarts.size(); l++) {
+            int ind = indentOf(l);
+            lineDepth[l] = ind <= 0 ? 0 : (ind <= 4 ? 1 : 2);
+            if (ind < 0) { lineDepth[l] = 2; continue; }
+            string t = lineText(l).substr(ind);
+            if (t.rfind("def ", 0) != 0 && t.rfind("class ", 0) != 0 && t.rfind("async def ", 0) != 0) continue;
+            size_t e = l + 1;
+            while (e < lineStarts.size() && (indentOf(e) < 0 || indentOf(e) > ind)) e++;
+            Block b;
+            b.start = lineStarts[l];
+            b.end = e < lineStarts.size() ? lineStarts[e] : file.size();
+            if (ind <= 4) b.name = definedName(t);
+            b.isType = ind == 0 && t.rfind("class ", 0) == 0;
+            blocks.push_back(b);
+        }
+    }
+};
+
 // [NEW] Metadata System for GlupeHub
 inline string stripMetadata(const string& code) {
     size_t start = code.find("META_START");
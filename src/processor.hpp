@@ -4,9 +4,12 @@
 #include "cache.hpp"
 #include "config.hpp"
 #include "languages.hpp"
+#include "graph.hpp"
+#include "shake.hpp"
 
 // [NEW] Pre-process input to handle containers and caching
-inline string processInputWithCache(const string& code, bool useCache, const vector<string>& updateTargets, bool fillMode) {
+// `tokens` is the lexGlupe() stream for `code` when the caller already has it.
+inline string processInputWithCache(const string& code, bool useCache, const vector<string>& updateTargets, bool fillMode, const vector<GlupeToken>* tokens = nullptr) {
     // [FUTURE v6.0] AST INTEGRATION POINT
     // 1. Normalize: Replace $$...$$ with valid placeholders (e.g. comments or void calls)
     // 2. Parse: auto tree = parser.parse_string(normalized_code);
@@ -18,92 +21,32 @@ inline string processInputWithCache(const string& code, bool useCache, const vec
     
     string result;
     size_t pos = 0;
-    
-    while (pos < code.length()) {
-        size_t start = code.find("$", pos);
-        if (start == string::npos) {
-            result += code.substr(pos);
-            break;
-        }
+
+    // Named containers found by the scan; resolved and generated after it in dependency order
+    struct ContainerDecl {
+        string id;
+        string prompt; // Raw child logic
+        vector<string> parents;
+        vector<string> params;
+        bool isAbstract;
+        size_t offset; // Splice point in `result`
+    };
+    vector<ContainerDecl> decls;
+
+    vector<GlupeToken> lexed;
+    if (!tokens) { lexed = lexGlupe(code); tokens = &lexed; }
+
+    for (const GlupeToken& tok : *tokens) {
+        if (tok.start < pos) continue; // Inside a container already consumed
 
         // [v6.0] Semantic Parsing
-        bool isBlock = false;
-        bool isInline = false;
-        bool isVarPersistent = false;
-        bool isVarEphemeral = false;
-        bool isConstant = false;
-        size_t scan = 0;
-
-        if (start + 1 < code.length() && code[start+1] == '$') {
-            if (start + 2 < code.length() && code[start+2] == ':') {
-                // $$: Persistent Variable
-                isVarPersistent = true;
-                scan = start + 3;
-            } else {
-                // $$ Block Container
-                isBlock = true;
-                scan = start + 2;
-            }
-        } else {
-            if (start + 1 < code.length() && code[start+1] == ':') {
-                isVarEphemeral = true;
-                scan = start + 2;
-            } else if (start + 7 <= code.length() && code.compare(start, 7, "$CONST:") == 0) {
-                isConstant = true;
-                scan = start + 7;
-            } else {
-            // Inline container check: $ ... { ... } ... $ on same line
-            size_t lineEnd = code.find('\n', start);
-            if (lineEnd == string::npos) lineEnd = code.length();
-            
-            size_t openB = code.find('{', start);
-            if (openB != string::npos && openB < lineEnd) {
-                // Look for } followed by $
-                size_t searchPos = openB + 1;
-                while (searchPos < lineEnd) {
-                    size_t closeB = code.find('}', searchPos);
-                    if (closeB == string::npos || closeB >= lineEnd) break;
-                    size_t check = closeB + 1;
-                    while (check < lineEnd && isspace(code[check])) check++;
-                    if (check < lineEnd && code[check] == '$') {
-                        isInline = true;
-                        scan = start + 1;
-                        break;
-                    }
-                    searchPos = closeB + 1;
-                }
-            }
-            }
-        }
+        bool isVarPersistent = tok.kind == GlupeTokenKind::VAR_PERSISTENT;
+        bool isVarEphemeral = tok.kind == GlupeTokenKind::VAR_EPHEMERAL;
+        bool isConstant = tok.kind == GlupeTokenKind::CONSTANT;
 
         // Handle Variables and Constants
         if (isVarPersistent || isVarEphemeral || isConstant) {
-            // Parse Variable Declaration
-            // Format: $...: ID -> VALUE \n
-            
-            // 1. Parse ID
-            while(scan < code.length() && isspace(code[scan])) scan++;
-            size_t idStart = scan;
-            while(scan < code.length() && (isalnum(code[scan]) || code[scan] == '_')) scan++;
-            string id = code.substr(idStart, scan - idStart);
-            
-            // 2. Parse Arrow ->
-            while(scan < code.length() && isspace(code[scan])) scan++;
-            if (scan + 1 < code.length() && code[scan] == '-' && code[scan+1] == '>') {
-                scan += 2;
-            } 
-
-            // 3. Parse Value (rest of line)
-            while(scan < code.length() && isspace(code[scan]) && code[scan] != '\n') scan++;
-            size_t valStart = scan;
-            size_t lineEnd = code.find('\n', scan);
-            if (lineEnd == string::npos) lineEnd = code.length();
-            
-            string value = code.substr(valStart, lineEnd - valStart);
-            // Trim trailing whitespace
-            size_t last = value.find_last_not_of(" \t\r");
-            if (last != string::npos) value = value.substr(0, last + 1);
-            else value = "";
+            string value = code.substr(tok.contentStart, tok.contentEnd - tok.contentStart);
 
             // Create SemanticNode (Placeholder for Phase 2)
             SemanticNode node;
@@ -111,285 +54,321 @@ inline string processInputWithCache(const string& code, bool useCache, const vec
             else if (isVarEphemeral) node.type = NodeType::VAR_EPHEMERAL;
             else node.type = NodeType::CONSTANT;
             
-            node.id = id;
+            node.id = tok.id;
             node.content = value;
-            node.hash = getContainerHash(value);
+            node.hash = sha256Hex(value);
             
-            SYMBOL_TABLE[id] = node; // [NEW] Store in symbol table
+            SYMBOL_TABLE[tok.id] = node; // [NEW] Store in symbol table
+            if (isVarPersistent) journalVariable(node);
             
-            if (VERBOSE_MODE) cout << "   [VAR] Detected " << (isConstant ? "CONST" : "VAR") << ": " << id << " = " << value << endl;
+            if (VERBOSE_MODE) cout << "   [VAR] Detected " << (isConstant ? "CONST" : "VAR") << ": " << tok.id << " = " << value << endl;
 
-            result += code.substr(pos, start - pos);
-            pos = lineEnd; 
+            result.append(code, pos, tok.start - pos);
+            pos = tok.end;
             continue;
         }
 
-        if (!isBlock && !isInline) {
-            result += code.substr(pos, start - pos + 1);
-            pos = start + 1;
-            continue;
-        }
+        // Anonymous, malformed or unclosed containers stay in the text as is
+        if (tok.kind != GlupeTokenKind::CONTAINER || !tok.closed) continue;
 
-        // Check named $$ "id" {
-        bool isNamed = false;
-        bool isAbstract = false; // [NEW] Track abstract status
-        string id;
-        vector<string> paramIds;  // [NEW] Context Injection params
-        vector<string> parentIds; // [NEW] Parent IDs for inheritance
-        size_t contentStart = 0;
-        
-        while(scan < code.length() && isspace(code[scan])) scan++;
-        
-        // [NEW] Check for ABSTRACT keyword
-        if (scan + 8 <= code.length() && code.compare(scan, 8, "ABSTRACT") == 0 && (scan + 8 == code.length() || isspace(code[scan+8]))) {
-            isAbstract = true;
-            scan += 8;
-            while(scan < code.length() && isspace(code[scan])) scan++;
-        }
+        // Resolution is deferred until every container is known, so parents may appear anywhere
+        result.append(code, pos, tok.start - pos); // Append text before container
+        decls.push_back({tok.id, code.substr(tok.contentStart, tok.contentEnd - tok.contentStart), tok.parents, tok.params, tok.isAbstract, result.size()});
+        pos = tok.end;
+    }
+    result.append(code, pos, string::npos);
 
-        if (scan < code.length() && code[scan] != '{') {
-            size_t idStart = scan;
-            // [UPDATED] Stop at '(' for params
-            while(scan < code.length() && !isspace(code[scan]) && code[scan] != '{' && code[scan] != '(' && !(code[scan] == '-' && scan+1 < code.length() && code[scan+1] == '>')) {
-                scan++;
-            }
-            
-            if (scan > idStart) {
-                id = code.substr(idStart, scan - idStart);
-                
-                // [NEW] Parse Parameters (Context Injection)
-                if (scan < code.length() && code[scan] == '(') {
-                    size_t pStart = scan + 1;
-                    size_t pEnd = code.find(')', pStart);
-                    if (pEnd != string::npos) {
-                        string paramStr = code.substr(pStart, pEnd - pStart);
-                        stringstream ss(paramStr);
-                        string segment;
-                        while(getline(ss, segment, ',')) {
-                            segment.erase(0, segment.find_first_not_of(" \t"));
-                            segment.erase(segment.find_last_not_of(" \t") + 1);
-                            if(!segment.empty()) paramIds.push_back(segment);
-                        }
-                        scan = pEnd + 1;
-                    }
-                }
+    // --- DEPENDENCY GRAPH ---
+    // Edges run from parents (->) and injected params (...) to the containers that use them.
+    map<string, size_t> declIndex;
+    for (size_t i = 0; i < decls.size(); i++) declIndex[decls[i].id] = i;
 
-                size_t brace = scan;
-                
-                // [NEW] Check for inheritance ->
-                while(brace < code.length() && isspace(code[brace])) brace++;
-                if (brace + 1 < code.length() && code[brace] == '-' && code[brace+1] == '>') {
-                     size_t pScan = brace + 2;
-                     while (pScan < code.length()) {
-                         while(pScan < code.length() && isspace(code[pScan])) pScan++;
-                         if (pScan >= code.length() || code[pScan] == '{') break;
-                         
-                         size_t pStart = pScan;
-                         while(pScan < code.length() && !isspace(code[pScan]) && code[pScan] != ',' && code[pScan] != '{') {
-                             pScan++;
-                         }
-                         if (pScan > pStart) {
-                             parentIds.push_back(code.substr(pStart, pScan - pStart));
-                         }
-                         
-                         while(pScan < code.length() && isspace(code[pScan])) pScan++;
-                         if (pScan < code.length() && code[pScan] == ',') pScan++;
-                         else if (code[pScan] == '{') { brace = pScan; break; }
-                     }
-                     brace = pScan;
-                }
+    DependencyGraph graph(decls.size());
+    for (size_t i = 0; i < decls.size(); i++) {
+        for (const auto& pid : decls[i].parents) if (declIndex.count(pid)) graph.addEdge(declIndex[pid], i);
+        for (const auto& pid : decls[i].params) if (declIndex.count(pid)) graph.addEdge(declIndex[pid], i);
+    }
 
-                while(brace < code.length() && isspace(code[brace])) brace++;
-                if (brace < code.length() && code[brace] == '{') {
-                    isNamed = true;
-                    contentStart = brace + 1;
-                }
+    vector<size_t> cyclic;
+    vector<size_t> order = graph.topoOrder(&cyclic);
+    if (!cyclic.empty()) {
+        string names;
+        for (size_t c : cyclic) names += (names.empty() ? "" : ", ") + decls[c].id;
+        cout << "   [WARN] Inheritance cycle between containers: " << names << ". Cyclic links ignored." << endl;
+        graph.dropEdgesWithin(cyclic);
+        order = graph.topoOrder();
+    }
+
+    // Resolve prompts parents-first. A child's prompt embeds its ancestors' resolved prompts,
+    // so its hash changes exactly when something in its ancestor cone changes.
+    vector<string> resolved(decls.size());
+    vector<string> hashes(decls.size());
+    for (size_t i : order) {
+        const ContainerDecl& d = decls[i];
+        string prompt = d.prompt;
+        
+        // [NEW] Logic Inheritance
+        string contextStr = "";
+        for (const auto& pid : d.parents) {
+            bool isDep = declIndex.count(pid) && find(graph.deps[i].begin(), graph.deps[i].end(), declIndex[pid]) != graph.deps[i].end();
+            if (isDep || (!declIndex.count(pid) && SYMBOL_TABLE.count(pid))) {
+                contextStr += "\n--- INHERITED FROM " + pid + " ---\n" + (isDep ? resolved[declIndex[pid]] : SYMBOL_TABLE[pid].content) + "\n";
+                cout << "   [INHERIT] Container '" << d.id << "' inherits from '" << pid << "'" << endl;
+            } else if (declIndex.count(pid)) {
+                cout << "   [WARN] Parent container '" << pid << "' of '" << d.id << "' skipped (cycle)." << endl;
+            } else {
+                cout << "   [WARN] Parent container '" << pid << "' not found." << endl;
             }
         }
 
-        if (isNamed) {
-            // Find end of container
-            size_t end = string::npos;
-            size_t nextPos = 0;
-
-            if (isBlock) {
-                end = code.find("}$$", contentStart);
-                if (end != string::npos) nextPos = end + 3;
+        // [NEW] Context Injection (Params)
+        for (const auto& pid : d.params) {
+            bool isDep = declIndex.count(pid) && find(graph.deps[i].begin(), graph.deps[i].end(), declIndex[pid]) != graph.deps[i].end();
+            if (isDep || (!declIndex.count(pid) && SYMBOL_TABLE.count(pid))) {
+                contextStr += "\n--- INJECTED CONTEXT (" + pid + ") ---\n" + (isDep ? resolved[declIndex[pid]] : SYMBOL_TABLE[pid].content) + "\n";
+                cout << "   [INJECT] Context '" << pid << "' injected into '" << d.id << "'" << endl;
             } else {
-                // Inline end finding
-                size_t lineEnd = code.find('\n', start);
-                if (lineEnd == string::npos) lineEnd = code.length();
-                size_t searchPos = contentStart;
-                while (searchPos < lineEnd) {
-                    size_t closeB = code.find('}', searchPos);
-                    if (closeB == string::npos || closeB >= lineEnd) break;
-                    size_t check = closeB + 1;
-                    while (check < lineEnd && isspace(code[check])) check++;
-                    if (check < lineEnd && code[check] == '$') {
-                        end = closeB;
-                        nextPos = check + 1;
-                        break;
-                    }
-                    searchPos = closeB + 1;
-                }
+                // If not in symbol table, treat as a raw parameter name for the AI
+                contextStr += "\n--- PARAMETER: " + pid + " ---\n";
             }
+        }
 
-            if (end == string::npos) {
-                // Malformed, just append and continue
-                result += code.substr(pos, (isBlock ? 2 : 1));
-                pos = start + (isBlock ? 2 : 1);
-                continue;
-            }
+        if (!contextStr.empty()) {
+            prompt = "CONTEXT:\n" + contextStr + "\nRESOLUTION RULES:\n1. Child logic overrides parent logic.\n2. Use injected context as data/functions.\n\n--- CHILD LOGIC (" + d.id + ") ---\n" + d.prompt;
+        }
+        resolved[i] = prompt;
+        vector<string> parentHashes;
+        for (size_t dep : graph.deps[i]) parentHashes.push_back(hashes[dep]);
+        hashes[i] = getContainerHash(prompt, parentHashes);
+
+        // Store resolved prompt in symbol table
+        SemanticNode containerNode;
+        containerNode.type = NodeType::CONTAINER;
+        containerNode.id = d.id;
+        containerNode.content = prompt;
+        containerNode.parents = d.parents;
+        containerNode.params = d.params;
+        containerNode.isAbstract = d.isAbstract;
+        containerNode.hash = hashes[i];
+        SYMBOL_TABLE[d.id] = containerNode;
+    }
 
-            string prompt = code.substr(contentStart, end - contentStart);
-            
-            // [NEW] Logic Inheritance
-            string contextStr = "";
-            if (!parentIds.empty()) {
-                for(const auto& pid : parentIds) {
-                    if (SYMBOL_TABLE.count(pid)) {
-                        contextStr += "\n--- INHERITED FROM " + pid + " ---\n" + SYMBOL_TABLE[pid].content + "\n";
-                        cout << "   [INHERIT] Container '" << id << "' inherits from '" << pid << "'" << endl;
-                    } else {
-                        cout << "   [WARN] Parent container '" << pid << "' not found (must be defined before use)." << endl;
-                    }
+    // Invalidation: report which dependents each changed container drags along
+    vector<bool> changed(decls.size());
+    for (size_t i = 0; i < decls.size(); i++) {
+        changed[i] = getLockedHash(decls[i].id) != hashes[i];
+    }
+    if (useCache) {
+        for (size_t i = 0; i < decls.size(); i++) {
+            if (!changed[i] || !LOCK_DATA["containers"].contains(decls[i].id)) continue;
+            bool ancestorChanged = false;
+            for (size_t dep : graph.deps[i]) if (changed[dep]) ancestorChanged = true;
+            if (ancestorChanged) continue;
+            string cone;
+            for (size_t d : graph.descendants({i})) if (changed[d]) cone += (cone.empty() ? "" : ", ") + decls[d].id;
+            if (!cone.empty()) cout << "   [DAG] '" << decls[i].id << "' changed; dependents to regenerate: " << cone << endl;
+        }
+    }
+
+    // Selective update (-u targets): the targets plus any dependent whose resolved prompt moved with them
+    set<size_t> updateCone;
+    if (useCache && !updateTargets.empty()) {
+        vector<size_t> roots;
+        for (const auto& t : updateTargets) if (declIndex.count(t)) roots.push_back(declIndex[t]);
+        updateCone.insert(roots.begin(), roots.end());
+        for (size_t d : graph.descendants(roots)) if (changed[d]) updateCone.insert(d);
+    }
+
+    // --- CACHE / GENERATION ---
+    vector<string> blocks(decls.size());
+    vector<string> cachedCode(decls.size());
+    vector<bool> needsFill(decls.size(), false);
+    for (size_t i = 0; i < decls.size(); i++) {
+        const ContainerDecl& d = decls[i];
+        const string& id = d.id;
+
+        // [NEW] Abstract Container Logic
+        if (d.isAbstract) {
+            cout << "   [ABSTRACT] Defined container: " << id << endl;
+            blocks[i] = "// [ABSTRACT: " + id + "]\n"; // Placeholder comment (no code generation)
+            LOCK_DATA["containers"][id]["hash"] = hashes[i]; // Tracked so edits can be traced to dependents
+            continue;
+        }
+
+        bool cacheHit = false;
+        
+        // Check if we should skip this container (Selective Update)
+        bool skipUpdate = useCache && !updateTargets.empty() && !updateCone.count(i);
+
+        if (useCache && (skipUpdate || LOCK_DATA["containers"].contains(id))) {
+            // If skipping, ignore hash check and try to load cache immediately
+            if (skipUpdate) {
+                string content = getCachedContent(getLockedHash(id));
+                if (!content.empty()) {
+                    cout << "   [SKIP] Keeping container: " << id << endl;
+                    blocks[i] = "\n// GLUPE_BLOCK_START: " + id + "\n" + content + "\n// GLUPE_BLOCK_END: " + id + "\n";
+                    cachedCode[i] = content;
+                    cacheHit = true;
+                } else {
+                    cout << "   [WARN] Cache missing for skipped container: " << id << ". Regenerating." << endl;
                 }
             }
-
-            // [NEW] Context Injection (Params)
-            if (!paramIds.empty()) {
-                for(const auto& pid : paramIds) {
-                    if (SYMBOL_TABLE.count(pid)) {
-                        contextStr += "\n--- INJECTED CONTEXT (" + pid + ") ---\n" + SYMBOL_TABLE[pid].content + "\n";
-                        cout << "   [INJECT] Context '" << pid << "' injected into '" << id << "'" << endl;
-                    } else {
-                        // If not in symbol table, treat as a raw parameter name for the AI
-                        contextStr += "\n--- PARAMETER: " + pid + " ---\n";
-                    }
+            // Standard check: hash comparison
+            else if (!changed[i]) {
+                string content = getCachedContent(hashes[i]);
+                if (!content.empty()) {
+                    cout << "   [CACHE] Using cached container: " << id << endl;
+                    // [FIX] Wrap cached content in markers so AI preserves it
+                    blocks[i] = "\n// GLUPE_BLOCK_START: " + id + "\n" + content + "\n// GLUPE_BLOCK_END: " + id + "\n";
+                    cachedCode[i] = content;
+                    cacheHit = true;
                 }
             }
+        }
 
-            if (!contextStr.empty()) {
-                string childLogic = prompt;
-                prompt = "CONTEXT:\n" + contextStr + "\nRESOLUTION RULES:\n1. Child logic overrides parent logic.\n2. Use injected context as data/functions.\n\n--- CHILD LOGIC (" + id + ") ---\n" + childLogic;
+        if (!cacheHit) {
+            if (fillMode) {
+                // [FILL MODE] Generated below once its parents are done
+                needsFill[i] = true;
+            } else {
+                // [STANDARD MODE] Wrap in markers for global pass
+                blocks[i] = "\n// GLUPE_BLOCK_START: " + id + "\n" + resolved[i] + "\n// GLUPE_BLOCK_END: " + id + "\n";
+                
+                // Update lock data (will be saved after successful generation)
+                LOCK_DATA["containers"][id]["hash"] = hashes[i];
+                LOCK_DATA["containers"][id]["last_run"] = time(nullptr);
             }
+        }
+    }
 
-            // Store resolved prompt in symbol table for future children
-            SemanticNode containerNode;
-            containerNode.type = NodeType::CONTAINER;
-            containerNode.id = id;
-            containerNode.content = prompt;
-            containerNode.parents = parentIds;
-            containerNode.params = paramIds;
-            SYMBOL_TABLE[id] = containerNode;
-
-            // [NEW] Abstract Container Logic
-            if (isAbstract) {
-                cout << "   [ABSTRACT] Defined container: " << id << endl;
-                result += code.substr(pos, start - pos); // Append text before container
-                result += "// [ABSTRACT: " + id + "]\n"; // Placeholder comment (no code generation)
-                pos = nextPos;
-                continue;
-            }
+    auto splice = [&](const function<string(size_t)>& blockFor) {
+        string out;
+        out.reserve(result.size());
+        size_t last = 0;
+        for (size_t i = 0; i < decls.size(); i++) {
+            out.append(result, last, decls[i].offset - last);
+            out += blockFor(i);
+            last = decls[i].offset;
+        }
+        out.append(result, last, string::npos);
+        return out;
+    };
+
+    size_t fillCount = count(needsFill.begin(), needsFill.end(), true);
+    if (fillCount > 0) {
+        // The file as every container sees it, with pending siblings shown as their prompts
+        string currentContext = splice([&](size_t i) {
+            return needsFill[i] ? "\n// GLUPE_BLOCK_START: " + decls[i].id + "\n" + resolved[i] + "\n// GLUPE_BLOCK_END: " + decls[i].id + "\n" : blocks[i];
+        });
+
+        int workers = (int)min((size_t)PARALLEL_JOBS, fillCount);
+        cout << "   [FILL] Generating " << fillCount << " container(s) with " << workers << " worker(s)..." << endl;
+
+        // Big files: each container gets its dependency slice instead of the whole file
+        size_t contextBudget = (size_t)CONTEXT_TOKENS * 4;
+        vector<pair<size_t, size_t>> promptSpans; // Pending containers hold prompts, not code: keep them out of the scan
+        for (size_t i = 0; i < decls.size(); i++) {
+            if (!needsFill[i]) continue;
+            string endMarker = "// GLUPE_BLOCK_END: " + decls[i].id;
+            size_t at = currentContext.find("// GLUPE_BLOCK_START: " + decls[i].id + "\n");
+            size_t endAt = (at == string::npos) ? string::npos : currentContext.find(endMarker, at);
+            if (endAt != string::npos) promptSpans.push_back({at, endAt + endMarker.size()});
+        }
+        FillContextBuilder contextBuilder(currentContext, contextBudget, promptSpans);
+        if (contextBudget > 0 && currentContext.size() > contextBudget) {
+            cout << "   [FILL] File context is " << currentContext.size() / 1024 << " KB; pruning it to ~" << CONTEXT_TOKENS << " tokens per container." << endl;
+        }
 
-            string currentHash = getContainerHash(prompt);
-            
-            result += code.substr(pos, start - pos); // Append text before container
+        vector<string> generated(decls.size());
+        mutex lockDataMutex;
 
-            bool cacheHit = false;
-            
-            // Check if we should skip this container (Selective Update)
-            bool skipUpdate = false;
-            if (useCache && !updateTargets.empty()) {
-                bool isTarget = false;
-                for(const auto& t : updateTargets) if(t == id) isTarget = true;
-                if (!isTarget) skipUpdate = true;
+        // Parents finish before their children so a child can build on the parent's actual code;
+        // independent subtrees run in parallel.
+        graph.run(workers, [&](size_t i) {
+            const ContainerDecl& d = decls[i];
+            if (!needsFill[i]) {
+                generated[i] = cachedCode[i];
+                return;
+            }
+            {
+                lock_guard<mutex> lock(LOG_MUTEX);
+                cout << "   [FILL] Generating container: " << d.id << "..." << endl;
             }
 
-            if (useCache && (skipUpdate || LOCK_DATA["containers"].contains(id))) {
-                // If skipping, ignore hash check and try to load cache immediately
-                if (skipUpdate) {
-                    string content = getCachedContent(id);
-                    if (!content.empty()) {
-                        cout << "   [SKIP] Keeping container: " << id << endl;
-                        result += "\n// GLUPE_BLOCK_START: " + id + "\n";
-                        result += content; 
-                        result += "\n// GLUPE_BLOCK_END: " + id + "\n";
-                        cacheHit = true;
-                    } else {
-                        cout << "   [WARN] Cache missing for skipped container: " << id << ". Regenerating." << endl;
-                    }
-                }
-                // Standard check: hash comparison
-                else if (LOCK_DATA["containers"].contains(id)) {
-                string storedHash = LOCK_DATA["containers"][id]["hash"];
-                if (storedHash == currentHash) {
-                    string content = getCachedContent(id);
-                    if (!content.empty()) {
-                        cout << "   [CACHE] Using cached container: " << id << endl;
-                        // [FIX] Wrap cached content in markers so AI preserves it
-                        result += "\n// GLUPE_BLOCK_START: " + id + "\n";
-                        result += content; 
-                        result += "\n// GLUPE_BLOCK_END: " + id + "\n";
-                        cacheHit = true;
-                    }
-                    }
-                }
+            string parentCode;
+            for (size_t dep : graph.deps[i]) {
+                if (decls[dep].isAbstract || generated[dep].empty() || generated[dep].find("ERROR:") == 0) continue;
+                parentCode += "\n--- IMPLEMENTATION OF " + decls[dep].id + " ---\n" + generated[dep] + "\n";
             }
 
-            if (!cacheHit) {
-                if (fillMode) {
-                    // [FILL MODE] Generate immediately to preserve surrounding code
-                    cout << "   [FILL] Generating container: " << id << "..." << endl;
-                    
-                    // Construct context from what we have processed so far + what remains
-                    // This gives the AI the full file view without being able to touch it
-                    string currentContext = result + code.substr(pos);
-                    
-                    stringstream aiPrompt;
-                    aiPrompt << "ROLE: Code Generator.\n";
-                    aiPrompt << "TASK: Implement the code for the container '" << id << "'.\n";
-                    aiPrompt << "LANGUAGE: " << CURRENT_LANG.name << "\n";
-                    aiPrompt << "CONTEXT:\n" << currentContext << "\n";
-                    aiPrompt << "CONTAINER PROMPT:\n" << prompt << "\n";
-                    aiPrompt << "OUTPUT: Only the code implementation. No markdown. No explanations.\n";
-
-                    string generated = callAI(aiPrompt.str());
-                    string cleanGenerated = extractCode(generated);
-                    
-                    result += "\n// GLUPE_BLOCK_START: " + id + "\n";
-                    result += cleanGenerated;
-                    result += "\n// GLUPE_BLOCK_END: " + id + "\n";
-                    
-                    // Update cache immediately
-                    setCachedContent(id, cleanGenerated);
-                    LOCK_DATA["containers"][id]["hash"] = currentHash;
-                    LOCK_DATA["containers"][id]["last_run"] = time(nullptr);
-                    saveCache();
-                } else {
-                    // [STANDARD MODE] Wrap in markers for global pass
-                    result += "\n// GLUPE_BLOCK_START: " + id + "\n";
-                    result += prompt; // The prompt for the AI
-                    result += "\n// GLUPE_BLOCK_END: " + id + "\n";
-                    
-                    // Update lock data (will be saved after successful generation)
-                    LOCK_DATA["containers"][id]["hash"] = currentHash;
-                    LOCK_DATA["containers"][id]["last_run"] = time(nullptr);
-                }
+            string startMarker = "// GLUPE_BLOCK_START: " + d.id + "\n";
+            string endMarker = "// GLUPE_BLOCK_END: " + d.id;
+            size_t at = currentContext.find(startMarker);
+            size_t endAt = (at == string::npos) ? string::npos : currentContext.find(endMarker, at);
+            string context = (endAt == string::npos) ? currentContext : contextBuilder.forContainer(at, endAt + endMarker.size() - at, resolved[i]);
+
+            // Shared part first (byte-identical across containers, so servers can reuse its KV
+            // cache), per-container part last
+            stringstream aiPrompt;
+            aiPrompt << "ROLE: Code Generator.\n";
+            aiPrompt << "LANGUAGE: " << CURRENT_LANG.name << "\n";
+            aiPrompt << "OUTPUT: Only the code implementation of the container named below. No markdown. No explanations.\n";
+            aiPrompt << "CONTEXT:\n" << context << "\n";
+            if (!parentCode.empty()) aiPrompt << "PARENT CODE (already generated, reuse it, do not redefine it):\n" << parentCode << "\n";
+            aiPrompt << "TASK: Implement the code for the container '" << d.id << "'.\n";
+            aiPrompt << "CONTAINER PROMPT:\n" << resolved[i] << "\n";
+
+            // A cancelled answer (wrong language) is retried at once; other errors fail the container
+            OutputInvariants rules;
+            rules.rejectPython = (CURRENT_LANG.id == "cpp" || CURRENT_LANG.id == "c");
+            string cleanGenerated;
+            for (int attempt = 1; attempt <= MAX_RETRIES; attempt++) {
+                cleanGenerated = extractCode(callAI(aiPrompt.str(), nullptr, rules.rejectPython ? makeStreamCheck(rules) : nullptr));
+                if (!isStreamAbort(cleanGenerated)) break;
+                lock_guard<mutex> lock(LOG_MUTEX);
+                cout << "   [FILL] Aborted " << d.id << " (" << cleanGenerated.substr(STREAM_ABORTED.size() + 2) << "), retrying..." << endl;
             }
+            generated[i] = cleanGenerated;
+
+            if (cleanGenerated.find("ERROR:") == 0) {
+                log("FILL_FAIL", d.id + ": " + cleanGenerated);
+                lock_guard<mutex> lock(LOG_MUTEX);
+                cout << "   [FILL] Failed container: " << d.id << " (" << cleanGenerated.substr(7) << ")" << endl;
+                return; // Do not cache failures
+            }
+
+            // Update cache as each container lands so an interrupted build keeps its progress
+            setCachedContent(hashes[i], cleanGenerated);
+            lock_guard<mutex> lock(lockDataMutex);
+            LOCK_DATA["containers"][d.id]["hash"] = hashes[i];
+            LOCK_DATA["containers"][d.id]["last_run"] = time(nullptr);
+            journalContainer(d.id);
+        });
 
-            pos = nextPos; 
-        } else {
-            // Anonymous or malformed, keep as is (or handle anonymous logic)
-            result += code.substr(pos, start - pos + (isBlock ? 2 : 1));
-            pos = start + (isBlock ? 2 : 1);
+        for (size_t i = 0; i < decls.size(); i++) {
+            if (needsFill[i]) blocks[i] = "\n// GLUPE_BLOCK_START: " + decls[i].id + "\n" + generated[i] + "\n// GLUPE_BLOCK_END: " + decls[i].id + "\n";
         }
     }
+
+    result = splice([&](size_t i) { return blocks[i]; });
+    if (fillMode && !decls.empty()) saveCache(); // Compact the journal into the snapshot
     return result;
 }
 
 // [NEW] Tree Shaking Logic
+// Local and deterministic where shake.hpp understands the language; the LLM pass is opt-in.
 inline string performTreeShaking(const string& code, const string& language) {
+    ShakeResult local = shakeUnusedCode(code, CURRENT_LANG.id);
+    if (local.analyzed) {
+        if (local.removed.empty()) return code;
+        string names;
+        for (size_t i = 0; i < local.removed.size() && i < 8; i++) names += (i ? ", " : "") + local.removed[i];
+        if (local.removed.size() > 8) names += ", ...";
+        cout << "   [OPTIMIZE] Tree shaking removed " << local.removed.size() << " unused definition(s): " << names << endl;
+        return local.code;
+    }
+    if (!LLM_SHAKE) return code;
+
     cout << "   [OPTIMIZE] Tree shaking (removing unused code)..." << endl;
     stringstream prompt;
     prompt << "ROLE: Senior Code Optimizer.\n";
@@ -402,8 +381,16 @@ inline string performTreeShaking(const string& code, const string& language) {
     prompt << "5. Return ONLY the cleaned code.\n";
     prompt << "CODE:\n" << code << "\n";
     
-    string response = callAI(prompt.str());
+    // Stop early if the answer drops an EXPORT or switches language; the original code is kept
+    OutputInvariants rules;
+    rules.exports = OutputInvariants::exportsIn(code);
+    rules.rejectPython = (language == "C++" || language == "C");
+    string response = callAI(prompt.str(), nullptr, (!rules.exports.empty() || rules.rejectPython) ? makeStreamCheck(rules) : nullptr, LLM_PRIORITY_LOW);
     string cleaned = extractCode(response);
+    if (isStreamAbort(cleaned)) {
+        cout << "   [WARN] Tree shaking aborted (" << cleaned.substr(STREAM_ABORTED.size() + 2) << "). Keeping original code." << endl;
+        return code;
+    }
 
     // [SAFETY] Verify that EXPORT directives were not lost during optimization
     if (code.find("EXPORT:") != string::npos && cleaned.find("EXPORT:") == string::npos) {
@@ -414,8 +401,9 @@ inline string performTreeShaking(const string& code, const string& language) {
     return (cleaned.find("ERROR:") == 0) ? code : cleaned; // Fallback if error
 }
 
-// [NEW] Post-process AI output to update cache
-inline string updateCacheFromOutput(string code) {
+// Removes the GLUPE_BLOCK marker lines from AI output, keeping what is between them.
+// `onBlock` sees each well-formed block's id, content and where the content starts in the result.
+inline string stripGlupeMarkers(const string& code, const function<void(const string& id, const string& content, size_t at)>& onBlock = nullptr) {
     string cleanCode;
     size_t pos = 0;
     
@@ -446,10 +434,7 @@ inline string updateCacheFromOutput(string code) {
 
         // Extract content
         string content = code.substr(idEnd + 1, blockEnd - (idEnd + 1));
-        
-        // Save to cache
-        setCachedContent(id, content);
-        cout << "   [CACHE] Updated container: " << id << endl;
+        if (onBlock) onBlock(id, content, cleanCode.size());
 
         cleanCode += content; // Keep content in final file
         
@@ -457,7 +442,191 @@ inline string updateCacheFromOutput(string code) {
         size_t markerEnd = code.find('\n', blockEnd);
         pos = (markerEnd == string::npos) ? code.length() : markerEnd + 1;
     }
+    return cleanCode;
+}
+
+// [NEW] Post-process AI output to update cache
+// Each updated container is journaled; `compact` folds the journal into .glupe.lock afterwards
+// (series mode defers that to the end of the run).
+inline string updateCacheFromOutput(string code, bool compact = true) {
+    string cleanCode = stripGlupeMarkers(code, [](const string& id, const string& content, size_t) {
+        // Save to cache (under the digest recorded for this container)
+        setCachedContent(getLockedHash(id), content);
+        journalContainer(id);
+        cout << "   [CACHE] Updated container: " << id << endl;
+    });
     
-    saveCache();
+    if (compact) saveCache();
+    else flushLockJournal();
     return cleanCode;
-}
\ No newline at end of file
+}
+// --- LOCALIZED REPAIR ---
+// When every compiler error of a pass points into generated containers, only those containers
+// are regenerated and the rest of the file stays byte-identical.
+
+struct GlupeBlock {
+    string id;
+    string content; // Text between the marker lines, as updateCacheFromOutput caches it
+    size_t offset = string::npos; // Where `content` starts in the marker-free file, if known
+};
+
+// Every well-formed GLUPE_BLOCK_START/END pair in `code`, in order, with its offset in
+// stripGlupeMarkers(code)
+inline vector<GlupeBlock> glupeBlocksIn(const string& code) {
+    vector<GlupeBlock> blocks;
+    stripGlupeMarkers(code, [&](const string& id, const string& content, size_t at) { blocks.push_back({id, content, at}); });
+    return blocks;
+}
+
+// Where a container's code sits in the marker-free file
+struct BlockSpan {
+    string id;
+    size_t begin, end;       // Byte range
+    int firstLine, lastLine; // 1-based, inclusive
+};
+
+// Places each block in `code`, in order: at its recorded offset, or, once post-processing (tree
+// shaking) has moved things, at the only place after the previous block where its content occurs.
+// Blocks that were rewritten, that could match more than one place (a lone `return 0;` may also be
+// preamble code), and blocks without code are not located and so never repaired alone.
+inline vector<BlockSpan> locateBlocks(const string& code, const vector<GlupeBlock>& blocks) {
+    vector<BlockSpan> spans;
+    size_t cursor = 0, lineAt = 0;
+    int line = 1;
+    for (const auto& b : blocks) {
+        if (b.content.find_first_not_of(" \t\r\n") == string::npos) continue;
+        size_t at = b.offset;
+        if (at == string::npos || at < cursor || code.compare(at, b.content.size(), b.content) != 0) {
+            at = code.find(b.content, cursor);
+            if (at != string::npos && code.find(b.content, at + 1) != string::npos) continue;
+        }
+        if (at == string::npos) continue;
+        line += count(code.begin() + lineAt, code.begin() + at, '\n');
+        size_t end = at + b.content.size();
+        size_t bodyEnd = (code[end - 1] == '\n') ? end - 1 : end;
+        spans.push_back({b.id, at, end, line, line + (int)count(code.begin() + at, code.begin() + bodyEnd, '\n')});
+        lineAt = at;
+        cursor = end;
+    }
+    return spans;
+}
+
+// The containers owning `lines`, or none when a line falls outside every located container
+inline set<string> blocksOwningLines(const vector<BlockSpan>& spans, const set<int>& lines) {
+    set<string> owners;
+    for (int l : lines) {
+        auto it = find_if(spans.begin(), spans.end(), [&](const BlockSpan& s) { return l >= s.firstLine && l <= s.lastLine; });
+        if (it == spans.end()) return {};
+        owners.insert(it->id);
+    }
+    return owners;
+}
+
+// Regenerates the `failing` containers of `code` with the compiler output attached and splices
+// them in place. `prompts` maps container ids to what they were asked to implement. Returns
+// false (code untouched) if any container could not be regenerated.
+inline bool repairContainers(string& code, vector<BlockSpan>& spans, const set<string>& failing, const string& diagnostics, const map<string, string>& prompts) {
+    vector<BlockSpan> targets;
+    for (const auto& s : spans) if (failing.count(s.id)) targets.push_back(s);
+    if (targets.empty()) return false;
+
+    // Shared part first, per-container part last (see the fill prompt)
+    stringstream shared;
+    shared << "ROLE: Code Repair.\n";
+    shared << "LANGUAGE: " << CURRENT_LANG.name << "\n";
+    shared << "OUTPUT: Only the corrected code of the container named below (what goes between its markers). No markers. No markdown. No explanations.\n";
+    shared << "CONTEXT (the whole file; compiler line numbers refer to it):\n" << code << "\n";
+    shared << "DIAGNOSTICS:\n" << diagnostics << "\n";
+
+    vector<string> fixed(targets.size());
+    OutputInvariants rules;
+    rules.rejectPython = (CURRENT_LANG.id == "cpp" || CURRENT_LANG.id == "c");
+    parallelFor(targets.size(), PARALLEL_JOBS, [&](size_t i) {
+        const BlockSpan& s = targets[i];
+        stringstream prompt;
+        prompt << shared.str();
+        prompt << "TASK: Container '" << s.id << "' (lines " << s.firstLine << "-" << s.lastLine << ") does not compile. Rewrite only this container so the file builds; do not repeat the rest of the file.\n";
+        auto p = prompts.find(s.id);
+        if (p != prompts.end()) prompt << "CONTAINER PROMPT:\n" << p->second << "\n";
+        prompt << "CURRENT CODE:\n" << code.substr(s.begin, s.end - s.begin) << "\n";
+        for (int attempt = 1; attempt <= MAX_RETRIES; attempt++) {
+            fixed[i] = extractCode(callAI(prompt.str(), nullptr, rules.rejectPython ? makeStreamCheck(rules) : nullptr));
+            if (!isStreamAbort(fixed[i])) break;
+        }
+    });
+    for (size_t i = 0; i < targets.size(); i++) {
+        if (fixed[i].find("ERROR:") == 0 || fixed[i].find_first_not_of(" \t\r\n") == string::npos) {
+            log("REPAIR_FAIL", targets[i].id + ": " + fixed[i]);
+            cout << "   [REPAIR] Could not regenerate " << targets[i].id << (fixed[i].empty() ? "" : " (" + fixed[i] + ")") << endl;
+            return false;
+        }
+    }
+
+    // Back to front, so earlier offsets stay valid; later blocks shift by the size change
+    vector<GlupeBlock> blocks;
+    for (const auto& s : spans) blocks.push_back({s.id, code.substr(s.begin, s.end - s.begin), s.begin});
+    for (size_t i = targets.size(); i-- > 0;) {
+        const BlockSpan& s = targets[i];
+        string body = fixed[i];
+        if (code[s.end - 1] == '\n' && (body.empty() || body.back() != '\n')) body += '\n';
+        code.replace(s.begin, s.end - s.begin, body);
+        for (auto& b : blocks) {
+            if (b.id == s.id) b.content = body;
+            else if (b.offset > s.begin) b.offset = b.offset + body.size() - (s.end - s.begin);
+        }
+        setCachedContent(getLockedHash(s.id), body);
+        journalContainer(s.id);
+        cout << "   [CACHE] Updated container: " << s.id << endl;
+    }
+    saveCache();
+    spans = locateBlocks(code, blocks);
+    return true;
+}
+
+// --- SPECULATIVE GENERATION ---
+// -speculate K: one pass asks for K differently sampled answers at once (the pool spreads them
+// over its endpoints) and builds each in its own scratch subdirectory as soon as it lands.
+
+struct SpeculativeCandidate {
+    string answer;          // extractCode() of the response; "ERROR: ..." if the request failed
+    string code;            // answer without GLUPE markers, as it was built
+    string dir;             // Where it was built
+    CmdResult build;
+    bool built = false;     // `build` holds a result
+    double seconds = 0;     // Request + build time
+};
+
+// The first candidate that builds wins: answers still streaming are cancelled and no other
+// build starts (builds already running finish first). Returns the winner, or -1.
+inline int speculate(const string& prompt, int k, const OutputInvariants& rules, const function<CmdResult(const string& code, const string& dir)>& build, vector<SpeculativeCandidate>& out) {
+    out.assign(k, SpeculativeCandidate());
+    atomic<int> winner{-1};
+    auto start = chrono::steady_clock::now();
+    parallelFor(k, k, [&](size_t i) {
+        SpeculativeCandidate& c = out[i];
+        StreamCheck valid = makeStreamCheck(rules);
+        StreamCheck check = [&, valid](const string& code, size_t from) -> string {
+            if (winner >= 0) return "another candidate already built";
+            return valid(code, from);
+        };
+        // Candidate 0 is what a normal pass would have asked for
+        c.answer = extractCode(callAI(prompt, nullptr, check, LLM_PRIORITY_NORMAL, (int)i));
+        if (winner < 0 && c.answer.find("ERROR:") != 0) {
+            c.code = stripGlupeMarkers(c.answer);
+            c.dir = scratchPath("spec/c" + to_string(i));
+            std::error_code ec;
+            fs::create_directories(c.dir, ec);
+            c.build = build(c.code, c.dir);
+            c.built = true;
+            int none = -1;
+            if (c.build.exitCode == 0) winner.compare_exchange_strong(none, (int)i);
+        }
+        c.seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+        lock_guard<mutex> lock(LOG_MUTEX);
+        cout << "   [SPECULATE] Candidate " << (i + 1) << "/" << k << ": "
+             << (winner == (int)i ? "built" : c.built ? "build failed" : isStreamAbort(c.answer) ? "cancelled" : c.answer.find("ERROR:") == 0 ? "request failed" : "skipped")
+             << " (" << fixed << setprecision(1) << c.seconds << "s)" << endl;
+        cout.unsetf(ios::floatfield);
+    });
+    return winner;
+}
@@ -0,0 +1,602 @@
+#pragma once
+#include "common.hpp"
+
+// --- LOCAL TREE SHAKING ---
+// Drops top-level definitions nothing reachable refers to, without asking the model. The file is
+// cut into top-level chunks; roots (entry point, globals, preprocessor lines, anything not
+// understood) are always kept, and a definition is kept once a kept chunk mentions its name.
+// Names are matched as plain identifiers, so a collision keeps code rather than losing it.
+
+struct ShakeResult {
+    bool analyzed = false;    // false: language or code the shaker does not handle
+    string code;
+    vector<string> removed;   // Names whose definitions were dropped
+};
+
+struct ShakeChunk {
+    size_t begin = 0, end = 0; // [begin, end) of the file, leading blank and comment lines included
+    bool root = true;
+    vector<string> defines;    // Names this chunk binds (kept if any of them is reached)
+    vector<string> aliases;    // ...and names that reach it without naming it (enumerators)
+    string owner;              // Kept together with `owner` (out-of-class member definitions)
+    set<string> refs;          // Identifiers it mentions
+};
+
+struct ShakeToken {
+    char kind;  // 'i' identifier, 'p' punctuation, 's' literal, '#' preprocessor line
+    string text;
+    size_t begin, end;
+};
+
+inline bool isShakeIdentStart(char c, bool js) { return isalpha(static_cast<unsigned char>(c)) || c == '_' || (js && c == '$'); }
+inline bool isShakeIdent(char c, bool js) { return isalnum(static_cast<unsigned char>(c)) || c == '_' || (js && c == '$'); }
+
+inline void addWords(const string& text, set<string>& out, bool js = false) {
+    for (size_t i = 0; i < text.size();) {
+        if (!isShakeIdentStart(text[i], js)) { i++; continue; }
+        size_t b = i;
+        while (i < text.size() && isShakeIdent(text[i], js)) i++;
+        if (b == 0 || !isdigit(static_cast<unsigned char>(text[b - 1]))) out.insert(text.substr(b, i - b));
+    }
+}
+
+// Tokens of C, C++ or JavaScript with comments dropped. Strings, numbers, regex and template
+// literals are single 's' tokens; C preprocessor lines are single '#' tokens.
+inline vector<ShakeToken> tokenizeCLike(const string& s, bool js) {
+    vector<ShakeToken> out;
+    size_t i = 0, n = s.size();
+    bool lineStart = true;
+    auto regexAllowed = [&]() {
+        if (out.empty()) return true;
+        const ShakeToken& t = out.back();
+        if (t.kind == 'p') return t.text != ")" && t.text != "]" && t.text != "}";
+        if (t.kind == 'i') {
+            static const set<string> kw = {"return", "typeof", "case", "do", "else", "in", "of", "new", "delete", "void", "throw", "yield", "await", "instanceof"};
+            return kw.count(t.text) > 0;
+        }
+        return false;
+    };
+    auto quoted = [&](size_t b, char q) {
+        i++;
+        while (i < n && s[i] != q) {
+            if (s[i] == '\\') i++;
+            else if (q != '`' && s[i] == '\n') break;
+            i++;
+        }
+        i = min(n, i + 1);
+        out.push_back({'s', s.substr(b, i - b), b, i});
+    };
+    while (i < n) {
+        char c = s[i];
+        if (c == '\n') { lineStart = true; i++; continue; }
+        if (isspace(static_cast<unsigned char>(c))) { i++; continue; }
+        if (c == '/' && i + 1 < n && s[i + 1] == '/') { while (i < n && s[i] != '\n') i++; continue; }
+        if (c == '/' && i + 1 < n && s[i + 1] == '*') {
+            size_t e = s.find("*/", i + 2);
+            i = (e == string::npos) ? n : e + 2;
+            continue;
+        }
+        if (!js && c == '#' && lineStart) {
+            size_t b = i;
+            while (i < n && !(s[i] == '\n' && s[i - 1] != '\\' && !(s[i - 1] == '\r' && i >= 2 && s[i - 2] == '\\'))) i++;
+            out.push_back({'#', s.substr(b, i - b), b, i});
+            continue;
+        }
+        lineStart = false;
+        if (isShakeIdentStart(c, js)) {
+            size_t b = i;
+            while (i < n && isShakeIdent(s[i], js)) i++;
+            string word = s.substr(b, i - b);
+            if (!js && i < n && s[i] == '"' && (word == "R" || word == "u8R" || word == "uR" || word == "UR" || word == "LR")) {
+                size_t open = s.find('(', i + 1);
+                if (open == string::npos) return {};
+                size_t close = s.find(")" + s.substr(i + 1, open - i - 1) + "\"", open);
+                i = (close == string::npos) ? n : close + (open - i) + 1;
+                out.push_back({'s', s.substr(b, i - b), b, i});
+                continue;
+            }
+            if (!js && i < n && (s[i] == '"' || s[i] == '\'') && (word == "u8" || word == "u" || word == "U" || word == "L")) { quoted(b, s[i]); continue; }
+            out.push_back({'i', word, b, i});
+            continue;
+        }
+        if (isdigit(static_cast<unsigned char>(c)) || (c == '.' && i + 1 < n && isdigit(static_cast<unsigned char>(s[i + 1])))) {
+            size_t b = i;
+            while (i < n && (isalnum(static_cast<unsigned char>(s[i])) || s[i] == '.' || s[i] == '_' ||
+                             (!js && s[i] == '\'' && i + 1 < n && isalnum(static_cast<unsigned char>(s[i + 1]))) ||
+                             ((s[i] == '+' || s[i] == '-') && strchr("eEpP", s[i - 1])))) i++;
+            out.push_back({'s', s.substr(b, i - b), b, i});
+            continue;
+        }
+        if (c == '"' || c == '\'' || (js && c == '`')) { quoted(i, c); continue; }
+        if (js && c == '/' && regexAllowed()) {
+            size_t b = i++;
+            bool inClass = false;
+            while (i < n && s[i] != '\n' && (inClass || s[i] != '/')) {
+                if (s[i] == '\\') i++;
+                else if (s[i] == '[') inClass = true;
+                else if (s[i] == ']') inClass = false;
+                i++;
+            }
+            i = min(n, i + 1);
+            while (i < n && isalpha(static_cast<unsigned char>(s[i]))) i++;
+            out.push_back({'s', s.substr(b, i - b), b, i});
+            continue;
+        }
+        out.push_back({'p', string(1, c), i, i + 1});
+        i++;
+    }
+    return out;
+}
+
+// Start of the line after `from` when nothing but blanks/comments follows `from` on it
+inline size_t nextLineStart(const string& s, size_t from, size_t limit) {
+    size_t nl = s.find('\n', from);
+    return (nl != string::npos && nl < limit) ? nl + 1 : from;
+}
+
+// Index of the token closing the bracket at `open` (tokens.size() if unbalanced)
+inline size_t matchingToken(const vector<ShakeToken>& t, size_t open, size_t limit) {
+    string o = t[open].text, c = (o == "(") ? ")" : (o == "[") ? "]" : (o == "<") ? ">" : "}";
+    int depth = 0;
+    for (size_t k = open; k < limit; k++) {
+        if (t[k].kind != 'p') continue;
+        if (t[k].text == o) depth++;
+        else if (t[k].text == c && --depth == 0) return k;
+    }
+    return t.size();
+}
+
+// Keeps the roots and everything they reach; `chunks` must tile the file in order
+inline ShakeResult shakeChunks(const string& code, const vector<ShakeChunk>& chunks) {
+    ShakeResult r;
+    r.analyzed = true;
+    map<string, vector<size_t>> definedBy, ownedBy;
+    for (size_t i = 0; i < chunks.size(); i++) {
+        for (const auto& d : chunks[i].defines) definedBy[d].push_back(i);
+        for (const auto& a : chunks[i].aliases) definedBy[a].push_back(i);
+        if (!chunks[i].owner.empty()) ownedBy[chunks[i].owner].push_back(i);
+    }
+
+    vector<bool> kept(chunks.size(), false);
+    vector<size_t> work;
+    auto keep = [&](size_t i) { if (!kept[i]) { kept[i] = true; work.push_back(i); } };
+    for (size_t i = 0; i < chunks.size(); i++) if (chunks[i].root) keep(i);
+    set<string> reached;
+    while (!work.empty()) {
+        size_t i = work.back();
+        work.pop_back();
+        for (const auto& ref : chunks[i].refs) {
+            if (!reached.insert(ref).second) continue;
+            for (size_t j : definedBy[ref]) keep(j);
+            for (size_t j : ownedBy[ref]) keep(j);
+        }
+    }
+
+    set<string> removed;
+    if (!chunks.empty()) r.code = code.substr(0, chunks.front().begin); // File header, shebang
+    for (size_t i = 0; i < chunks.size(); i++) {
+        if (kept[i]) { r.code.append(code, chunks[i].begin, chunks[i].end - chunks[i].begin); continue; }
+        for (const auto& d : chunks[i].defines) if (removed.insert(d).second) r.removed.push_back(d);
+    }
+    return r;
+}
+
+// C and C++: free functions, prototypes, classes/structs/unions/enums and out-of-class member
+// definitions are candidates. Everything else, including templates specializations and
+// operators (found by lookup, not by name), is a root. No main(): a library, left alone.
+inline ShakeResult shakeCLike(const string& code) {
+    vector<ShakeToken> t = tokenizeCLike(code, false);
+    if (t.empty()) return {};
+    // A macro that pastes (##) or stringifies (#) builds names no token spells out: leave the file alone
+    for (const auto& tok : t) {
+        if (tok.kind != '#') continue;
+        size_t d = tok.text.find_first_not_of(" \t", tok.text.find('#') + 1);
+        if (d != string::npos && tok.text.compare(d, 6, "define") == 0 && tok.text.find('#', d) != string::npos) return {};
+    }
+
+    vector<pair<size_t, size_t>> spans; // Token ranges [first, last]
+    int depth = 0;
+    size_t first = 0;
+    for (size_t k = 0; k < t.size(); k++) {
+        if (t[k].kind == '#' && depth == 0 && k == first) { spans.push_back({k, k}); first = k + 1; continue; }
+        if (t[k].kind != 'p') continue;
+        const string& p = t[k].text;
+        if (p == "{" || p == "(" || p == "[") depth++;
+        else if (p == "}" || p == ")" || p == "]") { if (--depth < 0) return {}; }
+        if (depth != 0) continue;
+        if (p == ";") { spans.push_back({first, k}); first = k + 1; }
+        else if (p == "}") {
+            // `struct X {...};` and `T x = {...};` run on to their `;`; function and namespace bodies end here
+            bool assign = false, paren = false, typeKw = false;
+            int d = 0;
+            for (size_t h = first; h < k; h++) {
+                if (t[h].kind == 'p') {
+                    if (d == 0 && t[h].text == "{") break;
+                    if (d == 0 && t[h].text == "=") assign = true;
+                    if (d == 0 && t[h].text == "(") paren = true;
+                    if (t[h].text == "{" || t[h].text == "(" || t[h].text == "[") d++;
+                    else if (t[h].text == "}" || t[h].text == ")" || t[h].text == "]") d--;
+                } else if (t[h].kind == 'i' && (t[h].text == "class" || t[h].text == "struct" || t[h].text == "union" || t[h].text == "enum")) typeKw = true;
+            }
+            if (!assign && !(typeKw && !paren)) { spans.push_back({first, k}); first = k + 1; }
+        }
+    }
+    if (depth != 0) return {};
+    if (first < t.size()) spans.push_back({first, t.size() - 1});
+
+    static const set<string> entryPoints = {"main", "wmain", "WinMain", "wWinMain", "DllMain"};
+    static const set<string> rootKeywords = {"namespace", "using", "typedef", "static_assert", "asm", "__asm__", "concept", "module", "import", "export"};
+    vector<ShakeChunk> chunks;
+    set<string> bodies, types;
+    vector<bool> prototype;
+    bool hasEntry = false;
+    size_t prevEnd = 0;
+    for (const auto& [a, b] : spans) {
+        ShakeChunk ch;
+        ch.begin = nextLineStart(code, prevEnd, t[a].begin);
+        prevEnd = t[b].end;
+        bool isPrototype = false;
+        for (size_t k = a; k <= b; k++) {
+            if (t[k].kind == 'i') ch.refs.insert(t[k].text);
+            else if (t[k].kind == '#') addWords(t[k].text, ch.refs);
+        }
+        chunks.push_back(ch);
+        ShakeChunk& c = chunks.back();
+        if (t[a].kind == '#') { prototype.push_back(false); continue; }
+
+        size_t h = a;
+        if (t[h].text == "template" && h + 1 <= b && t[h + 1].text == "<") {
+            size_t close = matchingToken(t, h + 1, b + 1);
+            if (close > b || close == h + 2) { prototype.push_back(false); continue; } // template<>: a specialization
+            h = close + 1;
+        }
+        while (h <= b) {
+            const string& w = t[h].text;
+            if (w == "static" || w == "inline" || w == "constexpr" || w == "consteval" || w == "virtual" || w == "explicit" || w == "_Noreturn" || w == "noreturn") h++;
+            else if (w == "[" && h + 1 <= b && t[h + 1].text == "[") h = matchingToken(t, h, b + 1) + 1;
+            else break;
+        }
+        size_t headEnd = h;
+        bool assign = false, special = false;
+        size_t paren = 0, typeKw = 0;
+        bool hasParen = false, hasTypeKw = false;
+        int d = 0;
+        for (; headEnd <= b; headEnd++) {
+            const ShakeToken& tk = t[headEnd];
+            if (tk.kind == 'i') {
+                if (tk.text == "operator" || tk.text == "__attribute__" || tk.text == "__declspec" || tk.text == "extern" || tk.text == "alignas") special = true;
+                if (d == 0 && !hasTypeKw && !hasParen && (tk.text == "class" || tk.text == "struct" || tk.text == "union" || tk.text == "enum")) { hasTypeKw = true; typeKw = headEnd; }
+                continue;
+            }
+            if (tk.kind != 'p') continue;
+            if (d == 0 && tk.text == "{") break;
+            if (d == 0 && tk.text == "=" && !hasParen) assign = true;
+            if (d == 0 && tk.text == "(" && !hasParen) { hasParen = true; paren = headEnd; }
+            if (tk.text == "{" || tk.text == "(" || tk.text == "[") d++;
+            else if (tk.text == "}" || tk.text == ")" || tk.text == "]") d--;
+        }
+        bool hasBody = headEnd <= b;
+        if (h > b || special || assign || rootKeywords.count(t[h].text)) { prototype.push_back(false); continue; }
+
+        if (hasTypeKw && !hasParen) {
+            size_t nk = typeKw + 1;
+            if (t[typeKw].text == "enum" && nk <= b && (t[nk].text == "class" || t[nk].text == "struct")) nk++;
+            if (nk <= b && t[nk].text == "[" && nk + 1 <= b && t[nk + 1].text == "[") nk = matchingToken(t, nk, b + 1) + 1;
+            if (nk > b || t[nk].kind != 'i' || (nk + 1 <= b && t[nk + 1].text == "<")) { prototype.push_back(false); continue; }
+            if (hasBody) {
+                size_t close = matchingToken(t, headEnd, b + 1);
+                if (close > b || !(close == b || (close + 1 == b && t[b].text == ";"))) { prototype.push_back(false); continue; } // Also declares variables
+                if (t[typeKw].text == "enum") {
+                    for (size_t k = headEnd + 1; k < close; k++) {
+                        if (t[k].kind == 'i' && (t[k - 1].text == "{" || t[k - 1].text == ",")) c.aliases.push_back(t[k].text);
+                    }
+                }
+            } else if (nk + 1 != b) { prototype.push_back(false); continue; } // `struct X;` only
+            c.defines.push_back(t[nk].text);
+            c.root = false;
+            types.insert(t[nk].text);
+            prototype.push_back(false);
+            continue;
+        }
+        if (hasParen && paren > h && t[paren - 1].kind == 'i') {
+            string name = t[paren - 1].text;
+            if (entryPoints.count(name)) { hasEntry = true; prototype.push_back(false); continue; }
+            if (all_of(name.begin(), name.end(), [](char ch) { return isupper(static_cast<unsigned char>(ch)) || isdigit(static_cast<unsigned char>(ch)) || ch == '_'; })) {
+                prototype.push_back(false); // TEST(...) { }: a macro that registers what it defines
+                continue;
+            }
+            size_t q = paren - 2;
+            if (q > h && t[q].text == "~") q--;
+            if (q > h && t[q].text == ":" && t[q - 1].text == ":") {
+                size_t o = q - 2;
+                if (o > h && t[o].text == ">") {
+                    int ang = 0;
+                    for (; o > h; o--) {
+                        if (t[o].text == ">") ang++;
+                        else if (t[o].text == "<" && --ang == 0) break;
+                    }
+                    o--;
+                }
+                if (o < h || o > b || t[o].kind != 'i') { prototype.push_back(false); continue; }
+                c.owner = t[o].text;
+                c.root = false;
+                prototype.push_back(false);
+                continue;
+            }
+            size_t close = matchingToken(t, paren, b + 1);
+            bool deleted = false;
+            for (size_t k = close; k <= b && k < headEnd; k++) if (t[k].text == "=") deleted = true; // = 0, = default, = delete
+            if (close > b || deleted) { prototype.push_back(false); continue; }
+            c.defines.push_back(name);
+            c.root = false;
+            if (hasBody) bodies.insert(name);
+            isPrototype = !hasBody;
+        }
+        prototype.push_back(isPrototype);
+    }
+    if (!hasEntry) return {};
+
+    // `int f(3);` parses like a prototype; only one whose function is defined here is one. A member
+    // definition whose class is not defined here cannot be tied to anything.
+    for (size_t i = 0; i < chunks.size(); i++) {
+        if (prototype[i] && !bodies.count(chunks[i].defines[0])) { chunks[i].root = true; chunks[i].defines.clear(); }
+        if (!chunks[i].owner.empty() && !types.count(chunks[i].owner)) { chunks[i].root = true; chunks[i].owner.clear(); }
+    }
+    for (size_t i = 0; i + 1 < chunks.size(); i++) chunks[i].end = chunks[i + 1].begin;
+    if (chunks.empty()) return {};
+    chunks.back().end = code.size();
+    return shakeChunks(code, chunks);
+}
+
+// Python: top-level def/class and import statements are candidates. Decorated definitions may
+// register themselves and stay. Code that looks names up dynamically, or has no module-level
+// call or `if __name__` block to start from, is left alone.
+inline ShakeResult shakePython(const string& code) {
+    static const vector<string> dynamic = {"globals(", "locals(", "getattr(", "eval(", "exec(", "__all__", "importlib", "__import__", "vars("};
+    for (const auto& d : dynamic) if (code.find(d) != string::npos) return {};
+
+    // Comment-free copy (same offsets) and the offsets of lines that start a statement
+    string masked = code;
+    vector<size_t> starts;
+    int depth = 0;
+    string triple;
+    bool continued = false;
+    size_t i = 0, n = code.size();
+    while (i < n) {
+        size_t lineEnd = code.find('\n', i);
+        if (lineEnd == string::npos) lineEnd = n;
+        char c0 = code[i];
+        if (depth == 0 && triple.empty() && !continued && i < lineEnd && c0 != ' ' && c0 != '\t' && c0 != '#' && c0 != '\r') starts.push_back(i);
+        continued = false;
+        for (size_t k = i; k < lineEnd; k++) {
+            char c = code[k];
+            if (!triple.empty()) {
+                if (c == '\\') k++;
+                else if (code.compare(k, 3, triple) == 0) { k += 2; triple.clear(); }
+                continue;
+            }
+            if (c == '#') { for (size_t m = k; m < lineEnd; m++) masked[m] = ' '; break; }
+            if (c == '"' || c == '\'') {
+                if (code.compare(k, 3, string(3, c)) == 0) { triple = string(3, c); k += 2; continue; }
+                for (k++; k < lineEnd && code[k] != c; k++) if (code[k] == '\\') k++;
+                continue;
+            }
+            if (c == '(' || c == '[' || c == '{') depth++;
+            else if (c == ')' || c == ']' || c == '}') depth = max(0, depth - 1);
+            else if (c == '\\' && (k + 1 == lineEnd || (k + 2 == lineEnd && code[k + 1] == '\r'))) continued = true;
+        }
+        i = lineEnd + 1;
+    }
+    if (starts.empty()) return {};
+
+    auto lineAt = [&](size_t p) { size_t e = masked.find('\n', p); return masked.substr(p, (e == string::npos ? n : e) - p); };
+    auto startsWithWord = [](const string& line, const string& w) { return line.compare(0, w.size(), w) == 0 && (line.size() == w.size() || !isShakeIdent(line[w.size()], false)); };
+
+    // Group statements: decorators join what they decorate, else/elif/except/finally their block
+    vector<pair<size_t, size_t>> stmts; // (offset of the first statement line, offset of the def/class/... line)
+    for (size_t k = 0; k < starts.size(); k++) {
+        string line = lineAt(starts[k]);
+        bool joins = !stmts.empty() && (lineAt(stmts.back().second)[0] == '@' ||
+                     startsWithWord(line, "else") || startsWithWord(line, "elif") || startsWithWord(line, "except") || startsWithWord(line, "finally"));
+        if (joins) stmts.back().second = (lineAt(stmts.back().second)[0] == '@') ? starts[k] : stmts.back().second;
+        else stmts.push_back({starts[k], starts[k]});
+    }
+
+    vector<ShakeChunk> chunks;
+    bool hasEntry = false;
+    for (size_t k = 0; k < stmts.size(); k++) {
+        ShakeChunk c;
+        c.begin = stmts[k].first;
+        // Blank lines and column-0 comments right above a statement belong to it
+        while (k > 0 && c.begin >= 2) {
+            size_t prev = code.rfind('\n', c.begin - 2);
+            size_t ps = (prev == string::npos) ? 0 : prev + 1;
+            string pl = code.substr(ps, c.begin - 1 - ps);
+            size_t nb = pl.find_first_not_of(" \t\r");
+            if (nb != string::npos && !(nb == 0 && pl[0] == '#')) break;
+            c.begin = ps;
+        }
+        c.end = (k + 1 < stmts.size()) ? stmts[k + 1].first : n;
+        chunks.push_back(c);
+    }
+    for (size_t k = 0; k < chunks.size(); k++) {
+        if (k + 1 < chunks.size()) chunks[k].end = chunks[k + 1].begin;
+        ShakeChunk& c = chunks[k];
+        addWords(masked.substr(stmts[k].first, c.end - stmts[k].first), c.refs);
+        string line = lineAt(stmts[k].second);
+        if (stmts[k].first != stmts[k].second) continue; // Decorated
+        string rest = line;
+        if (startsWithWord(rest, "async")) rest = rest.substr(rest.find_first_not_of(" \t", 5));
+        bool isDef = startsWithWord(rest, "def"), isClass = startsWithWord(rest, "class");
+        if (isDef || isClass) {
+            size_t b = rest.find_first_not_of(" \t", isDef ? 3 : 5), e = b;
+            while (e < rest.size() && isShakeIdent(rest[e], false)) e++;
+            if (b == string::npos || e == b) continue;
+            c.defines.push_back(rest.substr(b, e - b));
+            c.root = false;
+            continue;
+        }
+        if (startsWithWord(line, "import") || startsWithWord(line, "from")) {
+            string stmt = masked.substr(stmts[k].first, c.end - stmts[k].first);
+            for (char& ch : stmt) if (ch == '(' || ch == ')' || ch == '\\' || ch == '\n' || ch == '\r' || ch == '\t') ch = ' ';
+            string names = stmt;
+            if (startsWithWord(line, "from")) {
+                size_t im = stmt.find(" import ");
+                if (im == string::npos || stmt.find("__future__") < im) continue;
+                names = stmt.substr(im + 8);
+            } else names = stmt.substr(6);
+            if (names.find('*') != string::npos || names.find(';') != string::npos) continue;
+            vector<string> bound;
+            stringstream parts(names);
+            string part;
+            bool ok = true;
+            while (getline(parts, part, ',')) {
+                stringstream words(part);
+                vector<string> w;
+                string x;
+                while (words >> x) w.push_back(x);
+                if (w.empty()) continue;
+                if (w.size() == 3 && w[1] == "as") bound.push_back(w[2]);
+                else if (w.size() == 1) bound.push_back(w[0].substr(0, w[0].find('.')));
+                else ok = false;
+            }
+            if (!ok || bound.empty()) continue;
+            c.defines = bound;
+            c.root = false;
+            c.refs.clear(); // Its own names are not uses
+            continue;
+        }
+        size_t e = 0;
+        while (e < line.size() && (isShakeIdent(line[e], false) || line[e] == '.')) e++;
+        if (startsWithWord(line, "if") && line.find("__name__") != string::npos) hasEntry = true;
+        else if (e > 0 && line.find_first_not_of(" \t", e) != string::npos && line[line.find_first_not_of(" \t", e)] == '(') hasEntry = true;
+    }
+    if (!hasEntry || chunks.empty()) return {};
+    return shakeChunks(code, chunks);
+}
+
+// JavaScript (scripts and CommonJS): function and class declarations, `import` and
+// `const x = require(...)` at column 0 are candidates; the rest of the file is the entry.
+// Modules that export anything, or index themselves dynamically, are left alone.
+inline ShakeResult shakeJs(const string& code) {
+    vector<ShakeToken> t = tokenizeCLike(code, true);
+    if (t.empty()) return {};
+    for (size_t k = 0; k < t.size(); k++) {
+        const string& w = t[k].text;
+        bool next = k + 1 < t.size();
+        if (t[k].kind != 'i') continue;
+        if (w == "export" || (w == "module" && next && t[k + 1].text == ".") || (w == "exports" && next && t[k + 1].text == ".")) return {};
+        if (w == "eval" && next && t[k + 1].text == "(") return {};
+        if ((w == "this" || w == "globalThis" || w == "window" || w == "self") && next && t[k + 1].text == "[") return {};
+        if (w == "Function" && k > 0 && t[k - 1].text == "new") return {};
+    }
+
+    // First on its line and not the operand of what came before (`x =\nfunction f() {}`)
+    auto lineOf = [&](size_t pos) { return count(code.begin(), code.begin() + pos, '\n'); };
+    auto startsStatement = [&](size_t k) {
+        size_t ls = (t[k].begin == 0) ? string::npos : code.rfind('\n', t[k].begin - 1);
+        ls = (ls == string::npos) ? 0 : ls + 1;
+        if (code.find_first_not_of(" \t", ls) != t[k].begin) return false;
+        return k == 0 || t[k - 1].kind != 'p' || t[k - 1].text == ";" || t[k - 1].text == "}" || t[k - 1].text == ")" || t[k - 1].text == "]";
+    };
+    vector<ShakeChunk> chunks;
+    ShakeChunk root;
+    size_t prevEnd = 0;
+    int depth = 0;
+    auto flushRoot = [&](size_t upTo) {
+        root.end = upTo;
+        if (root.end > root.begin) chunks.push_back(root);
+        root = ShakeChunk();
+        root.begin = upTo;
+    };
+    bool hasEntry = false;
+    for (size_t k = 0; k < t.size(); k++) {
+        ShakeChunk c;
+        size_t last = t.size();
+        if (depth == 0 && t[k].kind == 'i' && startsStatement(k)) {
+            size_t f = k;
+            if (t[f].text == "async" && f + 1 < t.size()) f++;
+            if (t[f].text == "function" || t[f].text == "class") {
+                size_t nameAt = f + 1;
+                if (nameAt < t.size() && t[nameAt].text == "*") nameAt++;
+                if (nameAt < t.size() && t[nameAt].kind == 'i') {
+                    size_t open = nameAt + 1;
+                    if (t[f].text == "function") {
+                        if (open < t.size() && t[open].text == "(") open = matchingToken(t, open, t.size()) + 1;
+                        else open = t.size();
+                    } else while (open < t.size() && t[open].text != "{") open++;
+                    if (open < t.size() && t[open].text == "{") {
+                        last = matchingToken(t, open, t.size());
+                        c.defines.push_back(t[nameAt].text);
+                    }
+                }
+            } else if (t[k].text == "import" && k + 1 < t.size() && t[k + 1].kind != 's' && t[k + 1].text != "(") {
+                size_t from = k + 1;
+                while (from < t.size() && !(t[from].kind == 'i' && t[from].text == "from")) from++;
+                if (from + 1 < t.size() && t[from + 1].kind == 's') {
+                    last = from + 1;
+                    for (size_t m = k + 1; m < from; m++) {
+                        if (t[m].kind == 'i' && t[m].text != "as" && !(m + 1 < from && t[m + 1].text == "as")) c.defines.push_back(t[m].text);
+                    }
+                }
+            } else if ((t[k].text == "const" || t[k].text == "let" || t[k].text == "var") && k + 1 < t.size()) {
+                size_t eq = k + 1, close = t.size();
+                vector<string> names;
+                if (t[eq].kind == 'i') { names.push_back(t[eq].text); eq++; }
+                else if (t[eq].text == "{") {
+                    close = matchingToken(t, eq, t.size());
+                    for (size_t m = eq + 1; m < close && close < t.size(); m++) {
+                        if (t[m].kind == 'i' && (t[m + 1].text == "," || t[m + 1].text == "}")) names.push_back(t[m].text);
+                    }
+                    eq = close + 1;
+                }
+                if (!names.empty() && eq + 4 < t.size() && t[eq].text == "=" && t[eq + 1].text == "require" && t[eq + 2].text == "(" && t[eq + 3].kind == 's' && t[eq + 4].text == ")") {
+                    last = eq + 4;
+                    c.defines = names;
+                }
+            }
+        }
+        if (last < t.size() && last + 1 < t.size() && t[last + 1].text == ";") last++;
+        if (last + 1 < t.size() && lineOf(t[last + 1].begin) == lineOf(t[last].end)) last = t.size(); // `require(...).x`: not the whole statement
+        if (last < t.size() && !c.defines.empty()) {
+            c.begin = nextLineStart(code, prevEnd, t[k].begin);
+            flushRoot(c.begin);
+            size_t nl = code.find('\n', t[last].end);
+            c.end = (nl == string::npos) ? code.size() : nl + 1; // Nothing else is on that line
+            for (size_t m = k; m <= last; m++) {
+                if (t[m].kind == 'i') c.refs.insert(t[m].text);
+                else if (t[m].kind == 's') addWords(t[m].text, c.refs, true);
+            }
+            if (t[k].text == "import" || t[k].text == "const" || t[k].text == "let" || t[k].text == "var") c.refs.clear();
+            c.root = false;
+            chunks.push_back(c);
+            root.begin = c.end;
+            prevEnd = t[last].end;
+            k = last;
+            continue;
+        }
+        if (t[k].kind == 'p') {
+            if (t[k].text == "{" || t[k].text == "(" || t[k].text == "[") depth++;
+            else if ((t[k].text == "}" || t[k].text == ")" || t[k].text == "]") && --depth < 0) return {};
+        }
+        if (t[k].kind == 'i') root.refs.insert(t[k].text);
+        else if (t[k].kind == 's') addWords(t[k].text, root.refs, true);
+        hasEntry = true;
+        prevEnd = t[k].end;
+    }
+    flushRoot(code.size());
+    if (!hasEntry || depth != 0) return {};
+    for (size_t i = 0; i + 1 < chunks.size(); i++) chunks[i].end = chunks[i + 1].begin;
+    if (!chunks.empty()) { chunks.front().begin = 0; chunks.back().end = code.size(); }
+    return shakeChunks(code, chunks);
+}
+
+// Local tree shaking for `langId` (a LangProfile id). Multi-file answers (EXPORT blocks) are not
+// analyzed: a name used by one file may be defined in another.
+inline ShakeResult shakeUnusedCode(const string& code, const string& langId) {
+    if (code.find("EXPORT:") != string::npos) return {};
+    if (langId == "cpp" || langId == "c") return shakeCLike(code);
+    if (langId == "py") return shakePython(code);
+    if (langId == "js") return shakeJs(code);
+    return {};
+}
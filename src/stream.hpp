@@ -0,0 +1,312 @@
+#pragma once
+#include "common.hpp"
+
+// --- STREAMED LLM RESPONSES ---
+// Ollama streams NDJSON (one JSON object per line); OpenAI and Google stream SSE ("data: {...}"
+// lines). The decoder turns body bytes into model text, the extractor turns model text into code.
+
+// Strips a ``` fence the way extractCode always has: from the line after the first fence to the
+// last fence. Text without a complete fence pair is returned untouched.
+inline string stripCodeFences(const string& raw) {
+    size_t start = raw.find("```");
+    if (start == string::npos) return raw;
+    size_t end_line = raw.find('\n', start);
+    size_t end_block = raw.rfind("```");
+    if (end_line != string::npos && end_block != string::npos && end_block > end_line) {
+        return raw.substr(end_line + 1, end_block - end_line - 1);
+    }
+    return raw;
+}
+
+struct LlmStreamDecoder {
+    string protocol;
+    string text;         // Model output decoded so far
+    string error;        // Error object sent inside the stream
+    bool events = false; // At least one stream event was recognised (false: the server did not stream)
+    bool done = false;
+
+    explicit LlmStreamDecoder(string proto) : protocol(move(proto)) {}
+
+    // Feeds body bytes; returns the text decoded from the lines they completed
+    string feed(const char* data, size_t n) {
+        string out;
+        line.append(data, n);
+        size_t start = 0, nl;
+        while ((nl = line.find('\n', start)) != string::npos) {
+            out += decodeLine(line.substr(start, nl - start));
+            start = nl + 1;
+        }
+        line.erase(0, start);
+        return out;
+    }
+
+    // Decodes a final line that had no newline
+    string finish() {
+        string out = decodeLine(line);
+        line.clear();
+        return out;
+    }
+
+private:
+    string line; // Incomplete trailing line
+
+    string decodeLine(string l) {
+        if (!l.empty() && l.back() == '\r') l.pop_back();
+        if (l.empty()) return "";
+        if (protocol != "ollama") {
+            if (l.compare(0, 5, "data:") != 0) return ""; // event:, id:, retry: and ": keep-alive" comments
+            size_t v = l.find_first_not_of(' ', 5);
+            l = (v == string::npos) ? "" : l.substr(v);
+            if (l == "[DONE]") { done = true; events = true; return ""; }
+        }
+
+        json j = json::parse(l, nullptr, false);
+        if (j.is_discarded() || !j.is_object()) return "";
+
+        if (j.contains("error")) {
+            events = true;
+            if (j["error"].is_object() && j["error"].contains("message") && j["error"]["message"].is_string()) error = j["error"]["message"];
+            else error = j["error"].is_string() ? j["error"].get<string>() : j["error"].dump();
+            return "";
+        }
+
+        string piece;
+        if (j.contains("response")) {
+            events = true;
+            if (j["response"].is_string()) piece = j["response"];
+            if (j.value("done", false)) done = true;
+        } else if (j.contains("choices") && j["choices"].is_array() && !j["choices"].empty()) {
+            events = true;
+            const json& c = j["choices"][0];
+            if (c.contains("delta") && c["delta"].contains("content") && c["delta"]["content"].is_string()) piece = c["delta"]["content"];
+            else if (c.contains("message") && c["message"].contains("content") && c["message"]["content"].is_string()) piece = c["message"]["content"];
+            else if (c.contains("text") && c["text"].is_string()) piece = c["text"];
+        } else if (j.contains("candidates") && j["candidates"].is_array() && !j["candidates"].empty()) {
+            events = true;
+            const json& content = j["candidates"][0].value("content", json::object());
+            if (content.contains("parts") && content["parts"].is_array()) {
+                for (const auto& part : content["parts"]) {
+                    if (part.contains("text") && part["text"].is_string()) piece += part["text"].get<string>();
+                }
+            }
+        }
+        text += piece;
+        return piece;
+    }
+};
+
+// Called with the code extracted so far and the offset where the new part starts.
+// `from == 0` after text that was already shown turned out not to be code (a fence arrived later).
+typedef function<void(const string& code, size_t from)> CodeStreamHook;
+
+// Incremental stripCodeFences. `code` only grows while the fence structure stays the same, and
+// finish() guarantees it equals stripCodeFences(raw). Each chunk is scanned once.
+struct StreamingCodeExtractor {
+    string raw;        // Model text received so far
+    string code;       // Code extracted so far
+    int revision = 0;  // Bumped whenever code had to be withdrawn
+    CodeStreamHook onCode;
+
+    void feed(const string& text) {
+        if (text.empty()) return;
+        size_t scanFrom = raw.size() >= 2 ? raw.size() - 2 : 0; // A fence may straddle chunks
+        raw += text;
+
+        for (size_t p = raw.find("```", scanFrom); p != string::npos; p = raw.find("```", p + 1)) {
+            if (fenceStart == string::npos) fenceStart = p;
+            else if (contentStart != string::npos && p >= contentStart) lastFence = p;
+        }
+        if (fenceStart != string::npos && contentStart == string::npos) {
+            size_t nl = raw.find('\n', max(fenceStart, scanFrom));
+            if (nl != string::npos) {
+                contentStart = nl + 1;
+                size_t p = raw.find("```", contentStart);
+                for (; p != string::npos; p = raw.find("```", p + 1)) lastFence = p;
+            }
+        }
+
+        // Text before the first fence is prose once the fence opens; withdraw it
+        size_t begin = 0, end;
+        if (fenceStart == string::npos) {
+            end = raw.size() - trailingBackticks();
+        } else if (contentStart == string::npos) {
+            end = 0;
+        } else {
+            begin = contentStart;
+            end = (lastFence != string::npos) ? lastFence : raw.size() - trailingBackticks();
+        }
+        if (begin != codeBegin || end < begin + code.size()) {
+            codeBegin = begin;
+            if (!code.empty()) { code.clear(); revision++; publish(0); }
+        }
+        if (end > begin + code.size()) {
+            size_t from = code.size();
+            code.append(raw, begin + from, end - begin - from);
+            publish(from);
+        }
+    }
+
+    void finish() {
+        string final = stripCodeFences(raw);
+        if (final.compare(0, code.size(), code) == 0 && final.size() >= code.size()) {
+            if (final.size() == code.size()) return;
+            size_t from = code.size();
+            code = move(final);
+            publish(from);
+        } else {
+            code = move(final);
+            revision++;
+            publish(0);
+        }
+    }
+
+private:
+    size_t fenceStart = string::npos;   // First ```
+    size_t contentStart = string::npos; // Line after the first ```
+    size_t lastFence = string::npos;    // Last ``` after contentStart
+    size_t codeBegin = 0;               // Offset in raw that code starts at
+
+    size_t trailingBackticks() const {
+        size_t n = 0;
+        while (n < 2 && n < raw.size() && raw[raw.size() - 1 - n] == '`') n++;
+        return n;
+    }
+
+    void publish(size_t from) { if (onCode) onCode(code, from); }
+};
+
+// --- ONLINE OUTPUT VALIDATION ---
+// Structural rules a streamed answer must keep. Checked line by line as code arrives, so a
+// generation that has definitely gone wrong is cancelled instead of being read to the end and
+// compiled. Only violations that no later text can repair are reported.
+struct OutputInvariants {
+    bool checkBlocks = false;   // GLUPE_BLOCK markers must pair up without nesting
+    set<string> blockIds;       // ...and name containers from the prompt (empty: any id)
+    bool rejectPython = false;  // The target is C/C++: Python source is the wrong language
+    vector<string> exports;     // EXPORT: headers that must all survive, in this order
+
+    // Every GLUPE_BLOCK_START id in `code`. Only lines that are a marker count, so the prompt
+    // rule that explains the markers is not taken for one.
+    static set<string> blockIdsIn(const string& code) {
+        set<string> ids;
+        stringstream ss(code);
+        string line;
+        while (getline(ss, line)) {
+            string t = trimLine(line);
+            if (t.rfind("// GLUPE_BLOCK_START: ", 0) == 0) ids.insert(trimLine(t.substr(22)));
+        }
+        return ids;
+    }
+
+    // Every `EXPORT: "file"` header line in `code`, in order
+    static vector<string> exportsIn(const string& code) {
+        vector<string> out;
+        stringstream ss(code);
+        string line;
+        while (getline(ss, line)) {
+            string t = trimLine(line);
+            if (isExportHeader(t)) out.push_back(t);
+        }
+        return out;
+    }
+
+    // Feeds the code extracted so far (see CodeStreamHook); returns the violation, or "".
+    string check(const string& code, size_t from) {
+        if (from == 0) reset();
+        if (!violation.empty()) return violation;
+        size_t nl;
+        while ((nl = code.find('\n', scanned)) != string::npos) {
+            checkLine(code.substr(scanned, nl - scanned));
+            scanned = nl + 1;
+            if (!violation.empty()) break;
+        }
+        return violation;
+    }
+
+private:
+    size_t scanned = 0;
+    string openBlock;
+    set<string> closedBlocks;
+    size_t nextExport = 0;
+    bool inComment = false;
+    string violation;
+
+    void reset() {
+        scanned = 0; openBlock.clear(); closedBlocks.clear(); nextExport = 0; inComment = false; violation.clear();
+    }
+
+    static string trimLine(const string& s) {
+        size_t a = s.find_first_not_of(" \t\r");
+        if (a == string::npos) return "";
+        return s.substr(a, s.find_last_not_of(" \t\r") - a + 1);
+    }
+
+    static bool isExportHeader(const string& t) {
+        return t.rfind("EXPORT:", 0) == 0 && trimLine(t.substr(7)) != "END";
+    }
+
+    static bool isIdent(char c) { return isalnum(static_cast<unsigned char>(c)) || c == '_' || c == '.'; }
+
+    // `def name(...):`, `import a.b [as c]`, `from a import b`, `if __name__ == "__main__":` at column 0
+    static bool isPythonLine(const string& line) {
+        string t = trimLine(line);
+        if (line.empty() || line[0] == ' ' || line[0] == '\t') return false;
+        if (t.rfind("def ", 0) == 0 && t.find('(') != string::npos && t.back() == ':') return true;
+        if (t.rfind("if __name__ == ", 0) == 0 && t.back() == ':') return true;
+        if (t.rfind("from ", 0) == 0 && t.find(" import ") != string::npos && t.find(';') == string::npos) return true;
+        if (t.rfind("import ", 0) == 0 && t.find(';') == string::npos && t.find('<') == string::npos && t.find('"') == string::npos) {
+            size_t p = 7;
+            while (p < t.size() && (isIdent(t[p]) || t[p] == ' ' || t[p] == ',')) p++;
+            return p == t.size();
+        }
+        return false;
+    }
+
+    void checkLine(const string& line) {
+        string marker = checkBlocks ? trimLine(line) : "";
+        if (marker.rfind("// GLUPE_BLOCK_START: ", 0) == 0) {
+            string id = trimLine(marker.substr(22));
+            if (!openBlock.empty()) violation = "GLUPE_BLOCK_START: " + id + " opened inside " + openBlock;
+            else if (!blockIds.empty() && !blockIds.count(id)) violation = "unknown container marker " + id;
+            else if (closedBlocks.count(id)) violation = "container " + id + " emitted twice";
+            else openBlock = id;
+            return;
+        }
+        if (marker.rfind("// GLUPE_BLOCK_END: ", 0) == 0) {
+            string id = trimLine(marker.substr(20));
+            if (openBlock != id) violation = "GLUPE_BLOCK_END: " + id + (openBlock.empty() ? " without a start marker" : " while " + openBlock + " is open");
+            else { closedBlocks.insert(id); openBlock.clear(); }
+            return;
+        }
+
+        if (rejectPython) {
+            // Block comments may quote anything
+            bool commentLine = inComment;
+            size_t open = line.rfind("/*"), close = line.rfind("*/");
+            if (open != string::npos && (close == string::npos || close < open)) inComment = true;
+            else if (close != string::npos) inComment = false;
+            if (!commentLine && open == string::npos) {
+                if (trimLine(line).rfind("#include", 0) == 0 && line.find("Python.h") != string::npos) { violation = "includes Python.h instead of native code"; return; }
+                if (isPythonLine(line)) { violation = "Python code in a C/C++ answer: " + trimLine(line).substr(0, 60); return; }
+            }
+        }
+
+        if (nextExport < exports.size()) {
+            string t = trimLine(line);
+            if (isExportHeader(t)) {
+                auto it = find(exports.begin() + nextExport, exports.end(), t);
+                if (it == exports.end()) return; // A new file is not a lost one
+                if (it != exports.begin() + nextExport) { violation = "lost " + exports[nextExport]; return; }
+                nextExport++;
+            }
+        }
+    }
+};
+
+// Returns "" to keep reading or the reason to cancel the generation.
+typedef function<string(const string& code, size_t from)> StreamCheck;
+
+inline StreamCheck makeStreamCheck(const OutputInvariants& rules) {
+    auto state = make_shared<OutputInvariants>(rules);
+    return [state](const string& code, size_t from) { return state->check(code, from); };
+}
@@ -3,17 +3,29 @@
 
 // --- LOGGER SYSTEM ---
 inline ofstream logFile;
+inline mutex LOG_MUTEX; // Serializes log/console output from worker threads
 
+inline int processId() {
+    #ifdef _WIN32
+    return (int)GetCurrentProcessId();
+    #else
+    return (int)getpid();
+    #endif
+}
+
+// glupe.log is shared by every run in the directory; lines are flushed one at a time and the
+// session header names the process, so concurrent runs can be told apart.
 inline void initLogger() {
     logFile.open("glupe.log", ios::app);
     if (logFile.is_open()) {
         auto t = time(nullptr);
         auto tm = *localtime(&t);
-        logFile << "\n--- SESSION START (v" << CURRENT_VERSION << "): " << put_time(&tm, "%Y-%m-%d %H:%M:%S") << " ---\n";
+        logFile << "\n--- SESSION START (v" << CURRENT_VERSION << ", pid " << processId() << "): " << put_time(&tm, "%Y-%m-%d %H:%M:%S") << " ---" << endl;
     }
 }
 
 inline void log(string level, string message) {
+    lock_guard<mutex> lock(LOG_MUTEX);
     if (logFile.is_open()) {
         auto t = time(nullptr);
         auto tm = *localtime(&t);
@@ -22,6 +34,66 @@ inline void log(string level, string message) {
     if (VERBOSE_MODE) cout << "   [" << level << "] " << message << endl;
 }
 
+// --- SCRATCH SPACE ---
+// Every run keeps its temp files (build sources and binaries, request bodies, candidates) in its
+// own .glupe_tmp/<pid>_<n> directory, removed on exit, so concurrent glupe runs in one tree
+// (make -j over several .glp targets) never share a file. .glupe_tmp itself stays (--clean
+// removes it): deleting it on exit would race with a run that is just creating its directory.
+inline const string SCRATCH_ROOT = ".glupe_tmp";
+
+struct ScratchDir {
+    string id;
+    string path;
+    bool keep = false; // Leave it behind (a build the user was told to look at)
+    vector<string> besideSources; // Per-run files that live in the project dir (see sourceScratchPath)
+    mutex m;
+
+    ~ScratchDir() {
+        if (keep) return;
+        std::error_code ec;
+        for (const auto& f : besideSources) fs::remove(f, ec);
+        if (!path.empty()) fs::remove_all(path, ec);
+    }
+};
+inline ScratchDir SCRATCH;
+
+// This run's scratch directory name (unique among live runs), created on first use
+inline string scratchId() {
+    lock_guard<mutex> lock(SCRATCH.m);
+    if (SCRATCH.path.empty()) {
+        std::error_code ec;
+        fs::create_directories(SCRATCH_ROOT, ec);
+        for (int n = 0; n < 1000 && SCRATCH.path.empty(); n++) {
+            string id = to_string(processId()) + "_" + to_string(n);
+            fs::path dir = fs::path(SCRATCH_ROOT) / id;
+            if (fs::create_directory(dir, ec)) { SCRATCH.id = id; SCRATCH.path = dir.string(); } // false: left by a dead run
+            else if (ec) break;
+        }
+        if (SCRATCH.path.empty()) {
+            // Unwritable tree: fall back to the current directory, never to be removed
+            SCRATCH.id = to_string(processId());
+            SCRATCH.path = ".";
+            SCRATCH.keep = true;
+        }
+    }
+    return SCRATCH.id;
+}
+
+inline string scratchPath(const string& name) {
+    scratchId();
+    return (fs::path(SCRATCH.path) / name).string();
+}
+
+// Sources handed to a compiler stay in the project dir, where `mod foo;`, `import './x'`,
+// include("x.jl") and friends resolve against their siblings; the run id keeps the name unique.
+// Removed on exit like the scratch dir.
+inline string sourceScratchPath(const string& stem, const string& ext) {
+    string path = stem + "_" + scratchId() + ext;
+    lock_guard<mutex> lock(SCRATCH.m);
+    if (find(SCRATCH.besideSources.begin(), SCRATCH.besideSources.end(), path) == SCRATCH.besideSources.end()) SCRATCH.besideSources.push_back(path);
+    return path;
+}
+
 // --- SYSTEM UTILS ---
 
 inline CmdResult execCmd(string cmd) {
@@ -46,6 +118,13 @@ inline string getExt(string fname) {
     return (lastindex == string::npos) ? "" : fname.substr(lastindex); 
 }
 
+// .glupe_build.<target>.cache holds the input hash that last built `target`
+inline string buildCachePath(const string& target) {
+    string name = target;
+    for (char& c : name) if (!isalnum(static_cast<unsigned char>(c)) && c != '.' && c != '-' && c != '_') c = '_';
+    return ".glupe_build." + name + ".cache";
+}
+
 inline string formatDuration(long long seconds) {
     if (seconds < 60) return to_string(seconds) + "s";
     long long min = seconds / 60;
@@ -53,6 +132,24 @@ inline string formatDuration(long long seconds) {
     return to_string(min) + "m " + to_string(sec) + "s";
 }
 
+// Runs task(0..count-1) on up to `workers` threads. Indices are claimed in order.
+inline void parallelFor(size_t count, int workers, const function<void(size_t)>& task) {
+    size_t n = min((size_t)max(1, workers), count);
+    if (n <= 1) {
+        for (size_t i = 0; i < count; i++) task(i);
+        return;
+    }
+    atomic<size_t> next{0};
+    vector<thread> pool;
+    for (size_t w = 0; w < n; w++) {
+        pool.emplace_back([&]() {
+            size_t i;
+            while ((i = next++) < count) task(i);
+        });
+    }
+    for (auto& t : pool) t.join();
+}
+
 // --- HEURISTICS ---
 
 // Enhanced error detection for lazy transpilation
@@ -73,6 +170,30 @@ inline bool isFatalError(const string& errMsg) {
     return false;
 }
 
+// Lines of `file` that compiler/interpreter errors point at: gcc/clang/go/rustc "file:line:",
+// MSVC "file(line)" and Python 'File "file", line N'. Warnings and notes are ignored.
+inline set<int> diagnosticLines(const string& output, const string& file) {
+    set<int> lines;
+    string name = fs::path(file).filename().string();
+    if (name.empty()) return lines;
+    stringstream ss(output);
+    string line;
+    while (getline(ss, line)) {
+        if (line.find("warning:") != string::npos || line.find("note:") != string::npos) continue;
+        for (size_t p = line.find(name); p != string::npos; p = line.find(name, p + 1)) {
+            if (p > 0 && (isalnum(static_cast<unsigned char>(line[p - 1])) || line[p - 1] == '_')) continue;
+            size_t q = p + name.size();
+            if (line.compare(q, 8, "\", line ") == 0) q += 8;
+            else if (q < line.size() && (line[q] == ':' || line[q] == '(')) q++;
+            else continue;
+            size_t digits = q;
+            while (digits < line.size() && isdigit(static_cast<unsigned char>(line[digits]))) digits++;
+            if (digits > q && digits - q < 9) lines.insert(stoi(line.substr(q, digits - q)));
+        }
+    }
+    return lines;
+}
+
 // Heuristic to detect spaghetti/legacy code
 inline bool detectIfCodeIsSpaghetti(const string& code) {
     if (code.find("goto ") != string::npos) return true;
@@ -99,8 +220,39 @@ inline bool detectIfCodeIsSpaghetti(const string& code) {
 }
 
 // Execution Timer for -crono flag
+// phase(name) closes the running phase and opens the next one; repeated phases (one per pass)
+// accumulate. The report is printed when the timer goes out of scope, so every exit path of
+// main() is covered. `summary` lets the caller append counters (LLM traffic) to it.
 struct ExecutionTimer {
-    std::chrono::time_point<std::chrono::high_resolution_clock> start;
+    using Clock = std::chrono::high_resolution_clock;
+    Clock::time_point start;
+    Clock::time_point phaseStart;
+    string current = "setup";
+    vector<pair<string, double>> phases; // First-seen order
+    function<string()> summary;
     bool enabled = false;
-    ExecutionTimer() : start(std::chrono::high_resolution_clock::now()) {}
+    ExecutionTimer() : start(Clock::now()), phaseStart(start) {}
+
+    static double secondsSince(Clock::time_point t) {
+        return std::chrono::duration<double>(Clock::now() - t).count();
+    }
+
+    void phase(const string& name) {
+        double elapsed = secondsSince(phaseStart);
+        auto it = find_if(phases.begin(), phases.end(), [&](const pair<string, double>& p) { return p.first == current; });
+        if (it != phases.end()) it->second += elapsed;
+        else phases.push_back({current, elapsed});
+        current = name;
+        phaseStart = Clock::now();
+    }
+
+    ~ExecutionTimer() {
+        if (!enabled) return;
+        phase("");
+        cout << fixed << setprecision(3);
+        cout << "\n[CRONO] Total: " << secondsSince(start) << "s" << endl;
+        for (const auto& [name, secs] : phases) cout << "   [CRONO] " << name << ": " << secs << "s" << endl;
+        if (summary) cout << "   [CRONO] " << summary() << endl;
+        cout.unsetf(ios::floatfield);
+    }
 };
\ No newline at end of file
@@ -0,0 +1,313 @@
+#pragma once
+#include "utils.hpp"
+#include "languages.hpp"
+#include "digest.hpp"
+#include "cache.hpp"
+#ifndef _WIN32
+    #include <csignal>
+    #include <sys/wait.h>
+#endif
+
+// --- WARM VERIFICATION ---
+// Repair passes recompile the same prologue (system headers, crate graph, interpreter startup)
+// every time. What can be kept warm is kept: a precompiled header per include set and rustc's
+// incremental state live under CACHE_DIR, so they outlast the run and serve the next build of
+// any target; Python files are checked by one interpreter that stays up for the whole run.
+
+// System headers a PCH can stand in for: the `#include <...>` lines of the file's prologue.
+// Scanning stops at the first line that is not blank, a comment, #include or #pragma: a #define,
+// #if or declaration before an include could change what it expands to.
+inline vector<string> precompilableIncludes(const string& code) {
+    vector<string> includes;
+    stringstream ss(code);
+    string line;
+    bool inComment = false;
+    while (getline(ss, line)) {
+        size_t a = line.find_first_not_of(" \t\r");
+        if (a == string::npos) continue;
+        string t = line.substr(a);
+        if (inComment) { if (t.find("*/") != string::npos) inComment = false; continue; }
+        if (t.rfind("/*", 0) == 0) { inComment = t.find("*/", 2) == string::npos; continue; }
+        if (t.rfind("//", 0) == 0) continue;
+        if (t[0] != '#') break;
+        size_t d = t.find_first_not_of(" \t", 1);
+        if (d == string::npos) continue;
+        if (t.compare(d, 6, "pragma") == 0) continue;
+        if (t.compare(d, 7, "include") != 0) break;
+        size_t open = t.find('<', d + 7), close = t.find('>', d + 7);
+        if (open == string::npos || close == string::npos || close < open) continue; // "project" headers change too often
+        string inc = "#include " + t.substr(open, close - open + 1);
+        if (find(includes.begin(), includes.end(), inc) == includes.end()) includes.push_back(inc);
+    }
+    return includes;
+}
+
+// Where the PCH for this include set and compiler lives (header + .gch side by side)
+inline string precompiledHeaderPath(const vector<string>& includes) {
+    string key = CURRENT_LANG.buildCmd;
+    for (const auto& inc : includes) key += "\n" + inc;
+    string name = (CURRENT_LANG.id == "c") ? "glupe_pch.h" : "glupe_pch.hpp";
+    return CACHE_DIR + "/pch/" + sha256Hex(key).substr(0, 16) + "/" + name;
+}
+
+inline bool usesPrecompiledHeaders() {
+    return (CURRENT_LANG.id == "cpp" || CURRENT_LANG.id == "c") && !CURRENT_LANG.buildCmd.empty();
+}
+
+// Starts precompiling the system headers of `code` unless that PCH exists or is being built.
+// The compiler runs detached and publishes the .gch with a rename, so the next pass (or the next
+// build of any target with the same includes) picks it up once it is there and never waits.
+inline void warmUpToolchain(const string& code) {
+    if (!usesPrecompiledHeaders()) return;
+    vector<string> includes = precompilableIncludes(code);
+    if (includes.empty()) return;
+    fs::path header = precompiledHeaderPath(includes);
+    fs::path gch = header.string() + ".gch";
+    fs::path marker = header.string() + ".building";
+    std::error_code ec;
+    if (fs::exists(gch, ec)) return;
+    if (fs::exists(marker, ec)) {
+        auto age = fs::file_time_type::clock::now() - fs::last_write_time(marker, ec);
+        if (!ec && age < std::chrono::minutes(5)) return; // Another pass or run is on it
+    }
+    fs::create_directories(header.parent_path(), ec);
+    {
+        ofstream h(header);
+        for (const auto& inc : includes) h << inc << "\n";
+        ofstream m(marker);
+        m << processId();
+    }
+    string lang = (CURRENT_LANG.id == "c") ? "c-header" : "c++-header";
+    string tmp = gch.string() + "." + to_string(processId());
+    string cmd = CURRENT_LANG.buildCmd + " -x " + lang + " \"" + header.string() + "\" -o \"" + tmp + "\"";
+    #ifdef _WIN32
+    cmd = "start \"\" /b cmd /c \"" + cmd + " >nul 2>&1 && move /y \"" + tmp + "\" \"" + gch.string() + "\" >nul & del \"" + marker.string() + "\"\"";
+    #else
+    cmd = "(nice " + cmd + " && mv -f \"" + tmp + "\" \"" + gch.string() + "\"; rm -f \"" + tmp + "\" \"" + marker.string() + "\") >/dev/null 2>&1 &";
+    #endif
+    log("VERIFY", "Precompiling " + to_string(includes.size()) + " system headers into " + header.parent_path().string());
+    system(cmd.c_str());
+}
+
+inline string sourceText(const string& path) {
+    ifstream f(path, ios::binary);
+    return string((istreambuf_iterator<char>(f)), istreambuf_iterator<char>());
+}
+
+// Extra compiler flags that reuse warm state for building `src`: the PCH of its include set
+// (only once it is ready) or rustc's incremental directory.
+inline string warmBuildFlags(const string& src) {
+    if (CURRENT_LANG.id == "rust") return " -C incremental=\"" + CACHE_DIR + "/rust-incremental\"";
+    if (!usesPrecompiledHeaders()) return "";
+    vector<string> includes = precompilableIncludes(sourceText(src));
+    if (includes.empty()) return "";
+    string header = precompiledHeaderPath(includes);
+    std::error_code ec;
+    if (!fs::exists(header + ".gch", ec) || !fs::exists(header, ec)) return "";
+    return " -include \"" + header + "\"";
+}
+
+// One `python -c` loop for the whole run: it compiles each path it is sent and answers with the
+// exit code and the same SyntaxError text py_compile prints. POSIX only; elsewhere (or if the
+// interpreter cannot be started) the caller runs buildCmd as usual.
+struct ResidentPython {
+    mutex m;
+    bool started = false;
+    bool broken = false;
+    #ifndef _WIN32
+    pid_t pid = -1;
+    FILE* to = nullptr;
+    FILE* from = nullptr;
+
+    ~ResidentPython() {
+        if (to) fclose(to); // EOF on stdin ends the loop
+        if (from) fclose(from);
+        if (pid > 0) waitpid(pid, nullptr, 0);
+    }
+
+    bool start(const string& interpreter) {
+        static const char* script =
+            "import sys, traceback\n"
+            "for line in sys.stdin:\n"
+            "    path = line.rstrip('\\n')\n"
+            "    try:\n"
+            "        with open(path, 'rb') as f: compile(f.read(), path, 'exec')\n"
+            "        code, out = 0, b''\n"
+            "    except Exception as e:\n"
+            "        code, out = 1, ''.join(traceback.format_exception_only(type(e), e)).encode()\n"
+            "    sys.stdout.buffer.write(b'%d %d\\n' % (code, len(out)) + out)\n"
+            "    sys.stdout.buffer.flush()\n";
+        int in[2], out[2];
+        if (pipe(in) != 0) return false;
+        if (pipe(out) != 0) { close(in[0]); close(in[1]); return false; }
+        signal(SIGPIPE, SIG_IGN); // A dead interpreter must show up as a failed write
+        pid = fork();
+        if (pid < 0) { close(in[0]); close(in[1]); close(out[0]); close(out[1]); return false; }
+        if (pid == 0) {
+            dup2(in[0], 0);
+            dup2(out[1], 1);
+            int devnull = open("/dev/null", O_WRONLY);
+            if (devnull >= 0) dup2(devnull, 2);
+            close(in[0]); close(in[1]); close(out[0]); close(out[1]);
+            execlp(interpreter.c_str(), interpreter.c_str(), "-c", script, (char*)nullptr);
+            _exit(127);
+        }
+        close(in[0]);
+        close(out[1]);
+        fcntl(in[1], F_SETFD, FD_CLOEXEC); // Later children must not hold the interpreter's stdin open
+        fcntl(out[0], F_SETFD, FD_CLOEXEC);
+        to = fdopen(in[1], "w");
+        from = fdopen(out[0], "r");
+        return to && from;
+    }
+    #endif
+
+    // false: not available, run buildCmd instead
+    bool check(const string& src, CmdResult& result) {
+        #ifdef _WIN32
+        return false;
+        #else
+        lock_guard<mutex> lock(m);
+        if (broken) return false;
+        if (!started) {
+            started = true;
+            string interpreter = CURRENT_LANG.buildCmd.substr(0, CURRENT_LANG.buildCmd.find(' '));
+            if (!start(interpreter)) { broken = true; return false; }
+        }
+        int code = 0;
+        size_t len = 0;
+        if (fprintf(to, "%s\n", src.c_str()) < 0 || fflush(to) != 0 || fscanf(from, "%d %zu", &code, &len) != 2 || fgetc(from) != '\n') {
+            broken = true;
+            log("VERIFY", "Resident interpreter stopped; falling back to " + CURRENT_LANG.buildCmd);
+            return false;
+        }
+        string text(len, '\0');
+        if (len > 0 && fread(&text[0], 1, len, from) != len) { broken = true; return false; }
+        result = {text, code};
+        return true;
+        #endif
+    }
+};
+inline ResidentPython RESIDENT_PYTHON;
+
+// py_compile only parses, which is exactly what compile() does without the interpreter startup
+inline bool residentCheck(const string& src, CmdResult& result) {
+    if (CURRENT_LANG.id != "py" || CURRENT_LANG.buildCmd.find("-m py_compile") == string::npos) return false;
+    return RESIDENT_PYTHON.check(src, result);
+}
+
+// --- ARTIFACT CACHE ---
+// Build results (exit code, diagnostics and the binary) keyed by what decides them: the source,
+// the build command, the toolchain's version banner and the project files the source can pull in.
+// They sit in the content-addressed store, so identical code never compiles twice, in this
+// checkout or any other sharing GLUPE_CACHE_DIR.
+
+// `versionCmd` output, run once per process (the toolchain check and every cache key share it)
+inline const CmdResult& toolchainVersion() {
+    static mutex m;
+    static map<string, CmdResult> seen;
+    lock_guard<mutex> lock(m);
+    auto it = seen.find(CURRENT_LANG.versionCmd);
+    if (it == seen.end()) it = seen.emplace(CURRENT_LANG.versionCmd, execCmd(CURRENT_LANG.versionCmd)).first;
+    return it->second;
+}
+
+// Builds see the project's "headers" through -iquote ., so their contents are part of the key
+inline void hashLocalHeaders(const string& code, Sha256& h, set<string>& seen) {
+    stringstream ss(code);
+    string line;
+    while (getline(ss, line)) {
+        size_t a = line.find_first_not_of(" \t");
+        if (a == string::npos || line[a] != '#' || line.find("include", a) == string::npos) continue;
+        size_t open = line.find('"', a), close = (open == string::npos) ? open : line.find('"', open + 1);
+        if (close == string::npos) continue;
+        string name = line.substr(open + 1, close - open - 1);
+        if (!seen.insert(name).second) continue;
+        ifstream f(name, ios::binary);
+        if (!f.is_open()) { h.field(name).field(""); continue; }
+        string content((istreambuf_iterator<char>(f)), istreambuf_iterator<char>());
+        h.field(name).field(content);
+        hashLocalHeaders(content, h, seen);
+    }
+}
+
+// `syntaxTier`: the result may come from syntaxCmd alone (a tiered repair pass), so it is kept
+// apart from full-build results for the same source
+// Other languages resolve modules next to the source (`mod foo;`, `import './x'`, include("x.jl")):
+// every project file with the target's extension is part of the key. Hidden, cache and
+// dependency/output directories are not walked, and other runs' temp sources are left out.
+inline void hashSiblingModules(Sha256& h) {
+    static const set<string> skipDirs = {"node_modules", "target", "build", "__pycache__"};
+    vector<fs::path> files;
+    std::error_code ec;
+    fs::recursive_directory_iterator it(".", fs::directory_options::skip_permission_denied, ec), end;
+    for (; !ec && it != end; it.increment(ec)) {
+        string name = it->path().filename().string();
+        if (it->is_directory(ec)) {
+            if (name[0] == '.' || skipDirs.count(name) || fs::equivalent(it->path(), CACHE_DIR, ec)) it.disable_recursion_pending();
+            continue;
+        }
+        if (it->path().extension() == CURRENT_LANG.extension && name.rfind("temp_build", 0) != 0) files.push_back(it->path());
+    }
+    sort(files.begin(), files.end());
+    for (const auto& p : files) {
+        ifstream f(p, ios::binary);
+        string content((istreambuf_iterator<char>(f)), istreambuf_iterator<char>());
+        h.field(p.generic_string()).field(content);
+    }
+}
+
+inline string artifactKey(const string& code, bool syntaxTier) {
+    Sha256 h;
+    h.field("glupe-artifact-v2").field(CURRENT_LANG.id).field(CURRENT_LANG.buildCmd);
+    h.field(syntaxTier ? CURRENT_LANG.syntaxCmd : "");
+    h.field(toolchainVersion().output).field(code);
+    if (CURRENT_LANG.id == "cpp" || CURRENT_LANG.id == "c") {
+        set<string> seen;
+        hashLocalHeaders(code, h, seen);
+    } else {
+        hashSiblingModules(h);
+    }
+    return h.hex();
+}
+
+// Diagnostics name the scratch files they were built from; stored with placeholders instead
+inline string replaceAll(string s, const string& from, const string& to) {
+    if (from.empty()) return s;
+    for (size_t p = s.find(from); p != string::npos; p = s.find(from, p + to.size())) s.replace(p, from.size(), to);
+    return s;
+}
+
+// Restores the result recorded for `key` (and the binary, into `bin`); false on a miss
+inline bool loadArtifact(const string& key, const string& src, const string& bin, CmdResult& result) {
+    json entry = json::parse(getCachedContent(key), nullptr, false);
+    if (entry.is_discarded() || !entry.is_object() || !entry.contains("exitCode")) return false;
+    result.exitCode = entry.value("exitCode", 1);
+    result.output = replaceAll(replaceAll(entry.value("output", ""), "%FILE%", src), "%OUT%", bin);
+    if (result.exitCode == 0 && CURRENT_LANG.producesBinary) {
+        string binary = getCachedContent(entry.value("binary", ""));
+        if (binary.empty()) return false;
+        {
+            ofstream f(bin, ios::binary | ios::trunc);
+            f << binary;
+            if (!f) return false;
+        }
+        std::error_code ec;
+        fs::permissions(bin, fs::perms::owner_exec | fs::perms::group_exec | fs::perms::others_exec, fs::perm_options::add, ec);
+    }
+    return true;
+}
+
+// The binary goes in first, so an entry that can be read always has its binary
+inline void storeArtifact(const string& key, const string& src, const string& bin, const CmdResult& result) {
+    json entry = {{"exitCode", result.exitCode}, {"output", replaceAll(replaceAll(result.output, src, "%FILE%"), bin, "%OUT%")}};
+    if (result.exitCode == 0 && CURRENT_LANG.producesBinary) {
+        ifstream f(bin, ios::binary);
+        if (!f.is_open()) return;
+        string binary((istreambuf_iterator<char>(f)), istreambuf_iterator<char>());
+        string digest = sha256Hex(binary);
+        setCachedContent(digest, binary);
+        entry["binary"] = digest;
+    }
+    setCachedContent(key, entry.dump());
+}
@@ -21,7 +21,7 @@ if (-not (Test-Path $SrcDir)) { New-Item -ItemType Directory -Force -Path $SrcDi
 
 Write-Host "Downloading source code from $RepoBaseUrl..."
 try {
-    $SourceFiles = @("glupec.cpp", "common.hpp", "utils.hpp", "config.hpp", "languages.hpp", "ai.hpp", "cache.hpp", "parser.hpp", "processor.hpp", "hub.hpp")
+    $SourceFiles = @("glupec.cpp", "common.hpp", "utils.hpp", "config.hpp", "languages.hpp", "digest.hpp", "http.hpp", "balancer.hpp", "stream.hpp", "graph.hpp", "ai.hpp", "cache.hpp", "lexer.hpp", "parser.hpp", "shake.hpp", "processor.hpp", "verify.hpp", "hub.hpp")
     foreach ($file in $SourceFiles) {
         Invoke-WebRequest -Uri "$RepoBaseUrl/src/$file" -OutFile (Join-Path $SrcDir $file) -ErrorAction Stop
     }
@@ -32,7 +32,15 @@ try {
 }
 
 Write-Host "Compiling Glupe..."
-$BuildCmd = "g++ `"$SrcDir\glupec.cpp`" -o `"$tempBin`" -std=c++17 -static -static-libgcc -static-libstdc++ -lstdc++fs -O3 -I `"$SrcDir`""
+# Enable TLS for https:// endpoints when OpenSSL is available; otherwise they go through curl.
+$TlsFlags = ""
+$probeSrc = Join-Path $env:TEMP "glupe_tls_probe.cpp"
+Set-Content -Path $probeSrc -Value "#include <openssl/ssl.h>`nint main(){return OPENSSL_init_ssl(0,0)?0:1;}"
+& g++ $probeSrc -o (Join-Path $env:TEMP "glupe_tls_probe.exe") -static -lssl -lcrypto -lcrypt32 -lws2_32 2>$null
+if ($LASTEXITCODE -eq 0) { $TlsFlags = "-DGLUPE_TLS -lssl -lcrypto -lcrypt32" } else { Write-Host "OpenSSL not found: https:// endpoints will go through curl." }
+Remove-Item $probeSrc, (Join-Path $env:TEMP "glupe_tls_probe.exe") -ErrorAction SilentlyContinue
+
+$BuildCmd = "g++ `"$SrcDir\glupec.cpp`" -o `"$tempBin`" -std=c++17 -static -static-libgcc -static-libstdc++ -lstdc++fs $TlsFlags -lws2_32 -O3 -I `"$SrcDir`""
 try {
     Invoke-Expression $BuildCmd
 } catch {
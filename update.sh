@@ -22,7 +22,7 @@ echo "Downloading source code from $REPO_URL..."
 SRC_DIR="$GLUPE_DIR/src"
 mkdir -p "$SRC_DIR"
 
-SOURCE_FILES="glupec.cpp common.hpp utils.hpp config.hpp languages.hpp ai.hpp cache.hpp parser.hpp processor.hpp hub.hpp"
+SOURCE_FILES="glupec.cpp common.hpp utils.hpp config.hpp languages.hpp digest.hpp http.hpp balancer.hpp stream.hpp graph.hpp ai.hpp cache.hpp lexer.hpp parser.hpp shake.hpp processor.hpp verify.hpp hub.hpp"
 for file in $SOURCE_FILES; do
     if ! curl -fsSL "$REPO_URL/src/$file" -o "$SRC_DIR/$file"; then
         echo "Error: Failed to download $file"; exit 1
@@ -32,8 +32,17 @@ if ! curl -fsSL "$JSON_URL" -o "$SRC_DIR/json.hpp"; then
     echo "Error: Failed to download json.hpp"; exit 1
 fi
 
+# Enable TLS for https:// endpoints when OpenSSL is available; otherwise they go through curl.
+TLS_FLAGS=""
+if printf '#include <openssl/ssl.h>\nint main(){return OPENSSL_init_ssl(0,0)?0:1;}\n' \
+    | g++ -x c++ - -o /dev/null -lssl -lcrypto >/dev/null 2>&1; then
+    TLS_FLAGS="-DGLUPE_TLS -lssl -lcrypto"
+else
+    echo "OpenSSL not found: https:// endpoints will go through curl."
+fi
+
 echo "Compiling Glupe..."
-if ! g++ "$SRC_DIR/glupec.cpp" -o "$TEMP_BIN" -std=c++17 -O3 -pthread -I "$SRC_DIR"; then
+if ! g++ "$SRC_DIR/glupec.cpp" -o "$TEMP_BIN" -std=c++17 -O3 -pthread -I "$SRC_DIR" $TLS_FLAGS; then
     echo "Error: Compilation failed."
     exit 1
 fi